@@ -0,0 +1,89 @@
+#pragma once
+
+#include <cstddef>
+#include <memory>
+#include <ostream>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include <common.hpp>
+#include <emulator.hpp>
+#include <frame_ring.hpp>
+#include <runner.hpp>
+
+namespace mboy
+{
+/* Headless batch mode: a manifest of jobs, run on a Runner.
+ *
+ * The manifest has one job per line, '#' starts a comment:
+ *
+ *	<rom> <frames> [skip-boot] [input=<file>] [hash] [state=<file>] [screenshot=<file>]
+ *	      [ring=<name> [format=<indexed|grey|rgba>]] [check]
+ *
+ * A job runs the ROM for that many frames, with the buttons of the input
+ * file, and then writes what it asks for: hash is an FNV-1a hash of the
+ * final save state, state= the save state itself, screenshot= the screen
+ * as a binary PGM image in four shades of grey. ring= publishes every frame
+ * as it is drawn to the shared memory object name, in the format given,
+ * grey by default, see FrameRing. Without a screenshot or a ring no frame
+ * is drawn, see PPU::skip_frames(). The input file has lines of
+ * "<frame> <buttons>", buttons being a CPU::Button mask in hex that holds
+ * from that frame on.
+ *
+ * check runs a second instance alongside that goes an instruction at a time
+ * through CPU::exec(), without the block cache, idle loop skipping or the
+ * recompiler, and fails the job at the first frame after which the save
+ * states of the two differ.
+ *
+ * Every job prints one JSON object on a line of its own as soon as it is
+ * done, in the order they finish:
+ *
+ *	{"job":0,"rom":"a.gb","frames":600,"cycles":10533600,"hash":"...","ok":true}
+ *
+ * A job that fails has "ok":false and an "error" instead, the others go on.
+ */
+class Batch {
+    public:
+	/* Read the manifest at path, throws std::runtime_error on errors */
+	explicit Batch(const std::string &path);
+
+	/* Run all jobs, returns how many failed */
+	size_t run(Runner &runner, std::ostream &out);
+
+	[[nodiscard]] size_t jobs() const { return jobs_.size(); }
+
+    private:
+	static constexpr u64 slice_frames = 8;
+
+	struct Job {
+		std::string rom;
+		u64 frames = 0;
+		bool skip_boot = false;
+		std::string input;
+		bool hash = false;
+		std::string state;
+		std::string screenshot;
+		std::string ring;
+		FrameRing::Format format = FrameRing::grey;
+		bool check = false;
+
+		std::unique_ptr<FrameRing> frame_ring; // outlives emu, which publishes to it
+		std::unique_ptr<Emulator> emu;
+		std::unique_ptr<Emulator> reference; // runs exec() for check
+		std::vector<std::pair<u64, u8>> buttons; // from frame on
+		size_t next_buttons = 0;
+		u64 frame = 0;
+		std::string result; // JSON fields after "ok"
+		std::string error;
+	};
+
+	std::vector<Job> jobs_;
+
+	void start(Job &job);
+	void finish(Job &job);
+	static void compare(Job &job);
+	[[nodiscard]] static std::vector<std::pair<u64, u8>> read_input(const std::string &path);
+};
+
+} // namespace mboy
@@ -0,0 +1,91 @@
+#pragma once
+
+#include <cstddef>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include <common.hpp>
+#include <memory.hpp>
+
+namespace mboy
+{
+struct State;
+
+/* A ROM image and the memory bank controller on its cartridge.
+ *
+ * The image is mapped read-only, so every instance running the same ROM
+ * shares the kernel's page cache and loading only reads the header. Bank
+ * switches point the bus pages at another part of the image or the
+ * cartridge RAM instead of copying, writes to the ROM area reach the MBC
+ * through the page handlers.
+ *
+ * Supported are plain ROM (with or without RAM), MBC1, MBC2, MBC3 and MBC5.
+ * The MBC3 clock registers can be selected, latched and written, but the
+ * clock does not run.
+ */
+class Cartridge {
+    public:
+	enum class Mbc : u8 { none, mbc1, mbc2, mbc3, mbc5 };
+
+	/* Map the ROM at path, throws std::runtime_error if it is no usable ROM */
+	explicit Cartridge(const std::string &path);
+	Cartridge &operator=(const Cartridge &) = delete;
+
+	/* Put ROM and RAM on the bus of m */
+	void attach(Memory *m);
+
+	/* Copy-on-write branch
+	 * The same cartridge in the same state, to attach() to another bus.
+	 * Both share the ROM image, and the RAM until either writes to it:
+	 * meanwhile it is mapped read-only and the first write copies it.
+	 */
+	[[nodiscard]] std::unique_ptr<Cartridge> branch();
+
+	/* MBC registers and cartridge RAM of a save state, see state.hpp.
+	 * load() throws std::runtime_error if the RAM size does not match.
+	 */
+	void save(State &s) const;
+	void load(const State &s);
+
+	[[nodiscard]] const std::string &title() const { return title_; }
+	[[nodiscard]] Mbc mbc() const { return mbc_; }
+	[[nodiscard]] size_t rom_size() const { return rom_size_; }
+	[[nodiscard]] size_t ram_size() const { return ram_->size(); }
+
+    private:
+	Cartridge(const Cartridge &) = default;
+
+	static constexpr size_t rom_bank_size = 16 kB;
+	static constexpr size_t ram_bank_size = 8 kB;
+
+	std::shared_ptr<const u8> rom_map_; // the mapping, shared by branches
+	const u8 *rom_ = nullptr;
+	size_t rom_size_ = 0;
+	std::shared_ptr<std::vector<u8>> ram_ = std::make_shared<std::vector<u8>>();
+	bool ram_shared_ = false; // mapped without write pointers
+	std::string title_;
+	Mbc mbc_ = Mbc::none;
+
+	Memory *mem_ = nullptr;
+
+	/* MBC registers */
+	bool ram_enabled_ = false;
+	u16 rom_bank_ = 1; // 0x4000 - 0x7FFF, as written
+	u8 ram_bank_ = 0; // 0xA000 - 0xBFFF, MBC1: upper ROM bits; MBC3: >= 0x08 selects the clock
+	bool mode_ = false; // MBC1 banking mode
+	u8 rtc_[5] = {}; // MBC3 clock: seconds, minutes, hours, day low, day high
+	u8 latch_ = 0xFF;
+	u16 ram_view_ = 0x100; // what read_ram() serves, see remap()
+
+	void parse_header();
+	void remap();
+	void ram_changed();
+	[[nodiscard]] const u8 *rom_bank(unsigned bank) const;
+
+	static void write_mbc(void *ctx, u16 addr, u8 val);
+	static u8 read_ram(void *ctx, u16 addr);
+	static void write_ram(void *ctx, u16 addr, u8 val);
+};
+
+} // namespace mboy
@@ -4,9 +4,10 @@
 
 #define kB *1024
 
+using u64 = uint64_t;
 using u32 = uint32_t;
-using i32 = uint32_t;
+using i32 = int32_t;
 using u16 = uint16_t;
-using i16 = uint16_t;
+using i16 = int16_t;
 using u8 = uint8_t;
-using i8 = uint8_t;
+using i8 = int8_t;
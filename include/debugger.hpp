@@ -1,6 +1,7 @@
 #pragma once
 
 #include <ncurses.h>
+#include <string>
 
 #include <cpu.hpp>
 #include <memory.hpp>
@@ -13,8 +14,8 @@ public:
 
 	void step();
 
-	CPU cpu_;
-	Memory mem_;
+	CPU &cpu_;
+	Memory &mem_;
 
 private:
 	void init_ui();
@@ -0,0 +1,76 @@
+#pragma once
+
+#include <memory>
+#include <string>
+
+#include <cartridge.hpp>
+#include <common.hpp>
+#include <cpu.hpp>
+#include <memory.hpp>
+#include <ppu.hpp>
+#include <state.hpp>
+
+namespace mboy
+{
+/* One Game Boy: CPU, bus, PPU and the cartridge in its slot.
+ *
+ * Everything an instance changes is owned by it; instances only share what
+ * is read-only, the opcode tables, the boot ROM, the mapped ROM images and
+ * the page of zeros RAM reads as until it is written. A branch() shares
+ * RAM with its parent as well, but copies each part before writing to it.
+ * Any number of them can run side by side, one thread at a time each.
+ * The parts point at each other, so an Emulator stays where it was
+ * constructed and is neither copied nor moved.
+ */
+class Emulator {
+    public:
+	static constexpr u64 frame_cycles = 17556; // M-cycles per frame of 154 lines
+
+	/* Power on with the cartridge at rom inserted, none if rom is empty.
+	 * Starts in the boot ROM unless skip_boot, see CPU::skip_boot().
+	 * Throws std::runtime_error if the ROM cannot be loaded.
+	 */
+	explicit Emulator(const std::string &rom = {}, bool skip_boot = false);
+	Emulator(const Emulator &) = delete;
+	Emulator &operator=(const Emulator &) = delete;
+
+	/* Copy-on-write branch
+	 * A second machine in the same state, for a search or a rewind to try
+	 * out another future. It shares internal RAM with this one page by page
+	 * and cartridge RAM as a whole until either side writes to it, see
+	 * Memory(Memory &, Memory::Branch) and Cartridge::branch(). The CPU,
+	 * PPU and MBC registers are copied and attached to the branch's own bus,
+	 * the block cache starts out empty and no frames are published.
+	 */
+	[[nodiscard]] std::unique_ptr<Emulator> branch();
+
+	/* Run for at least n M-cycles, see CPU::run_for() */
+	u64 run_for(u64 n) { return cpu_.run_for(n); }
+
+	/* Save states, see state.hpp */
+	void save(State &s, u32 since = 0);
+	void load(const State &s);
+
+	[[nodiscard]] CPU &cpu() { return cpu_; }
+	[[nodiscard]] Memory &mem() { return mem_; }
+	[[nodiscard]] PPU &ppu() { return ppu_; }
+	[[nodiscard]] Cartridge *cart() { return cart_.get(); }
+
+    private:
+	Emulator(Emulator &other, Memory::Branch b);
+
+	Memory mem_;
+	CPU cpu_;
+	PPU ppu_;
+	std::unique_ptr<Cartridge> cart_;
+};
+
+/* What an instance costs before it writes to RAM: the page table, a CPU
+ * of three cache lines, the framebuffer and the decoded tiles. Everything
+ * else is on the heap, RAM pages once they are written, the cartridge RAM
+ * and the block cache.
+ */
+static_assert(sizeof(CPU) <= 3 * 64, "CPU grew past three cache lines");
+static_assert(sizeof(Memory) <= 13 kB, "Memory grew past its budget");
+
+} // namespace mboy
@@ -0,0 +1,111 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <string>
+
+#include <common.hpp>
+
+namespace mboy
+{
+/* Finished frames in shared memory, for other processes to read in place.
+ *
+ * The memory holds a Header, then slots of a Slot followed by one frame
+ * each, line by line in the format asked for:
+ *
+ *	indexed	2 bits a pixel, the shades of PPU::frame(), four pixels to
+ *		the byte with the leftmost in bits 7 - 6
+ *	grey	a byte a pixel, from 0xFF (white) to 0x00 (black) as in
+ *		screenshots
+ *	rgba	four bytes a pixel, R, G and B of that grey and A = 0xFF
+ *
+ * Frame n, counting from 1, goes to slot (n - 1) % slots. The writer never
+ * waits: a reader that falls behind misses frames, it does not hold them
+ * up. Instead of a lock each slot has a sequence counter, odd while the slot
+ * is written and 2n once it holds frame n, and the Header counts the frames
+ * published. A reader takes the newest frame like this:
+ *
+ *	n = published (acquire), slot (n - 1) % slots
+ *	if the slot's seq (acquire) is not 2n, it is already written again
+ *	read the pixels where they are
+ *	fence (acquire), if seq (relaxed) is not 2n any more, drop what was read
+ *
+ * The slot of frame n is written again for frame n + slots, which is how
+ * long a reader has to be done with it.
+ *
+ * With a name the memory is a POSIX shared memory object, which consumers
+ * shm_open() and mmap() read-only. It stays after the writer is gone, the
+ * consumer shm_unlink()s it when done, just as screenshots stay on disk.
+ * An existing one is reused and starts over at published = 0. Without a
+ * name it is an anonymous memfd, for children that inherit fd() or
+ * processes that open /proc/<pid>/fd/<fd>.
+ */
+class FrameRing {
+    public:
+	enum Format : u32 {
+		indexed,
+		grey,
+		rgba,
+	};
+
+	static constexpr u32 version = 1;
+	static constexpr u32 default_slots = 4;
+
+	struct Header {
+		char magic[8]; // "MBOYRING"
+		u32 version;
+		u32 format;
+		u32 width;
+		u32 height;
+		u32 stride; // bytes from one line to the next
+		u32 slots;
+		u64 slot_size; // bytes from one Slot to the next, pixels included
+		alignas(64) std::atomic<u64> published; // frames, on a cache line of its own
+	};
+
+	struct alignas(64) Slot {
+		std::atomic<u64> seq;
+		u64 frame; // PPU::frames() at its VBlank
+		u64 cycles; // cycle the VBlank began at
+		// the pixels follow on the next cache line
+	};
+
+	/* Create the ring as the shared memory object name, an anonymous memfd
+	 * if empty. Throws std::runtime_error if it cannot be created or mapped.
+	 */
+	FrameRing(const std::string &name, Format format, u32 slots = default_slots);
+	~FrameRing();
+	FrameRing(const FrameRing &) = delete;
+	FrameRing &operator=(const FrameRing &) = delete;
+
+	/* indexed, grey or rgba, throws std::runtime_error for others */
+	[[nodiscard]] static Format format(const std::string &name);
+
+	/* Convert the PPU::width x PPU::height shades at frame into the next
+	 * slot, then publish it
+	 */
+	void publish(const u8 *frame, u64 frame_no, u64 cycles);
+
+	[[nodiscard]] u64 published() const { return published_; }
+	[[nodiscard]] int fd() const { return fd_; }
+	[[nodiscard]] size_t size() const { return size_; }
+
+    private:
+	int fd_ = -1;
+	u8 *base_ = nullptr;
+	size_t size_ = 0;
+	Format format_;
+	u32 stride_;
+	u32 slots_;
+	u64 slot_size_;
+	u64 published_ = 0;
+
+	[[nodiscard]] Header &header() { return *reinterpret_cast<Header *>(base_); }
+	void convert(const u8 *frame, u8 *out) const;
+};
+
+// readers in other processes see the same atomics and offsets
+static_assert(std::atomic<u64>::is_always_lock_free, "shared counters need lock-free atomics");
+static_assert(sizeof(FrameRing::Header) == 128 && sizeof(FrameRing::Slot) == 64, "ring layout changed");
+
+} // namespace mboy
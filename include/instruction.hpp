@@ -0,0 +1,22 @@
+#pragma once
+
+#include <array>
+
+#include <common.hpp>
+
+namespace mboy
+{
+/* Static description of an opcode.
+ * Everything the dispatch loop does not need to execute an instruction lives
+ * here, apart from the function pointers in CPU::ops and CPU::cb_ops.
+ */
+struct Instruction {
+	char name_[16];
+	u16 opcode_;
+	u8 num_args_;
+};
+
+extern const std::array<Instruction, 256> instructions; // 0x00 - 0xFF
+extern const std::array<Instruction, 256> cb_instructions; // 0xCB00 - 0xCBFF
+
+} // namespace mboy
@@ -0,0 +1,111 @@
+#pragma once
+
+#include <cstddef>
+#include <deque>
+#include <initializer_list>
+#include <unordered_map>
+#include <vector>
+
+#include <common.hpp>
+#include <cpu.hpp>
+
+namespace mboy
+{
+/* x86-64 recompiler for hot blocks of the block cache.
+ *
+ * A block which ran hot_threshold times is translated into a native function
+ * taking the CPU. Inside it the SM83 registers live in host registers,
+ * chosen so that the 8-bit halves map onto the legacy byte registers:
+ *
+ *   AF = ax (A = ah)   BC = bx (B = bh, C = bl)   DE = cx   HL = dx   SP = si
+ *
+ * PC is a constant at every point of a block and is only stored when needed.
+ * Register loads, 16-bit increments and unconditional jumps are emitted
+ * natively, everything else calls its interpreter handler directly, so flags
+ * and memory accesses keep their exact interpreter behaviour.
+ *
+ * A block ends in patchable jumps to the blocks it can continue with. They
+ * are linked while the target is compiled and taken while the cycle budget
+ * and the next event allow it, otherwise they return to CPU::run_for().
+ * Native instructions do not check for events: a block is only entered if
+ * it ends before the next one, and after every handler call it returns if
+ * the handler moved an event before its end, such as EI or a write to IF.
+ * The interpreter loop runs the rest. A write to code unlinks every
+ * block: the stale ones are recompiled when the block cache decodes them
+ * again, the others are linked again when they next run.
+ */
+class Jit {
+    public:
+	Jit();
+	~Jit();
+	Jit(const Jit &) = delete;
+	Jit &operator=(const Jit &) = delete;
+
+	/* Run b, which starts at addr, natively if it is hot and cannot exceed
+	 * end. Returns false if the interpreter has to run it instead.
+	 */
+	bool run(CPU &cpu, CPU::Block &b, u16 addr, u64 end);
+
+    private:
+	typedef void (*native_fn)(CPU *cpu, u64 end);
+
+	static constexpr u16 hot_threshold = 16;
+	static constexpr size_t arena_size = 4 << 20;
+	static constexpr size_t max_code_len = 8 << 10; // code of a single block
+
+	/* Longest a block can take: 6 M-cycles for every instruction and the
+	 * extra cycles of a taken branch. A chained block is only entered when
+	 * at least this much is left until the end of the budget and the next
+	 * event.
+	 */
+	static constexpr u64 max_block_cycles = 6 * CPU::max_block_len + 3;
+
+	/* A patchable jmp rel32 at the end of a block */
+	struct Slot {
+		u8 *rel_;
+		u8 *exit_; // where the jump goes while unlinked
+	};
+
+	u8 *arena_ = nullptr;
+	size_t used_ = 0;
+
+	std::deque<CPU::DecodedOp> ops_; // operands of the compiled handler calls
+	std::vector<Slot> slots_;
+	std::unordered_map<u16, std::vector<size_t>> targets_; // slots_ by target address
+	std::unordered_map<u16, u8 *> entries_; // linkable blocks
+
+	u32 code_gen_ = 0;
+	u32 epoch_ = 1; // bumped whenever everything was unlinked
+
+	/* Offsets of the CPU state accessed by the native code */
+	struct {
+		i32 AF, BC, DE, HL, SP, PC, cycles, imm, mem, code_gen, next_event;
+	} off_;
+
+	/* Translation state */
+	u8 *code_ = nullptr; // write position
+	bool in_regs_ = false; // registers are held in host registers
+	u32 pending_ = 0; // cycles of native instructions not yet added
+	std::vector<u8 *> exits_; // jumps to the epilogue
+
+	[[nodiscard]] u8 *compile(CPU &cpu, CPU::Block &b, u16 addr);
+	void flush(CPU &cpu);
+	void link(u16 addr, u8 *entry);
+	void unlink();
+	static void patch(u8 *rel, u8 *target);
+
+	/* Emitters */
+	void emit(std::initializer_list<u8> bytes);
+	void emit16(u16 v);
+	void emit32(u32 v);
+	void emit64(u64 v);
+	[[nodiscard]] u8 *emit_jump(std::initializer_list<u8> opcode);
+	void spill();
+	void reload();
+	void add_cycles(u32 n);
+	void store_pc(u16 pc);
+	[[nodiscard]] bool native(u8 op, const CPU::DecodedOp &d);
+	void call(const CPU::DecodedOp &d, u16 pc, u32 left);
+};
+
+} // namespace mboy
@@ -0,0 +1,33 @@
+#pragma once
+
+#include <cstddef>
+
+#include <common.hpp>
+
+namespace mboy
+{
+/* The pixel loops of the PPU, in variants for what the host supports.
+ *
+ * Tile data is planar: each row of 8 pixels is a byte of low bits followed
+ * by a byte of high bits, the leftmost pixel in bit 7. decode() turns n of
+ * these rows into 8 colour numbers each, map() turns n colour numbers into
+ * shades through a palette register such as BGP.
+ *
+ * Besides the scalar loops there are SSE2 and AVX2 ones on x86, which do
+ * 8 rows or 16 to 32 pixels at a time with compares and byte shuffles.
+ * best() picks the fastest the CPU it runs on supports, so one binary runs
+ * everywhere. All variants give the same results.
+ */
+struct PixelKernels {
+	const char *name;
+	void (*decode)(const u8 *rows, u8 *px, size_t n);
+	void (*map)(const u8 *px, u8 *out, u8 palette, size_t n);
+
+	/* Chosen on first use */
+	[[nodiscard]] static const PixelKernels &best();
+
+	/* Runs on any host */
+	static const PixelKernels scalar;
+};
+
+} // namespace mboy
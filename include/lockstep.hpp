@@ -0,0 +1,124 @@
+#pragma once
+
+#include <array>
+#include <bitset>
+#include <cstddef>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include <common.hpp>
+#include <emulator.hpp>
+
+namespace mboy
+{
+/* Many copies of one ROM, stepped in lockstep (experimental).
+ *
+ * Copies that started alike and get similar input tend to run the very same
+ * instructions, only on different data. While every lane is at the same PC
+ * and cycle, with the same code there, Lockstep decodes each instruction
+ * once and runs it for all lanes at a time: the registers of the lanes lie
+ * side by side, one vector per register and group of lanes, so register
+ * and ALU instructions are a few vector operations for a whole group.
+ * Loads and stores, including the stack, go to each lane's bus in turn.
+ *
+ * Anything else, such as events, interrupts, HALT, DAA, EI/DI, the (HL)
+ * forms of the 0xCB opcodes or a branch only some lanes take, runs on each
+ * lane's own CPU for one instruction. Lanes which end up at different
+ * places run the rest of run_for() on their own, and are taken back into
+ * lockstep by the next run_for() once they meet again.
+ *
+ * The vector width is that of the target: 16 lanes with SSE2, 32 with
+ * AVX2, 64 with AVX-512BW. The simd build option makes use of the wider
+ * ones, the binary then only runs on CPUs that have them. Every lane ends
+ * up exactly where its Emulator would on its own.
+ */
+class Lockstep {
+    public:
+	/* lanes Emulators with the cartridge at rom, see Emulator::Emulator() */
+	Lockstep(const std::string &rom, size_t lanes, bool skip_boot = false);
+	Lockstep(const Lockstep &) = delete;
+	Lockstep &operator=(const Lockstep &) = delete;
+
+	/* Run every lane for at least n M-cycles, see CPU::run_for() */
+	void run_for(u64 n);
+
+	[[nodiscard]] Emulator &lane(size_t i) { return *lanes_[i]; }
+	[[nodiscard]] size_t lanes() const { return lanes_.size(); }
+
+	/* Instructions run for all lanes at once, and run by a single lane */
+	[[nodiscard]] u64 shared() const { return shared_; }
+	[[nodiscard]] u64 alone() const { return alone_; }
+
+    private:
+#if defined(__AVX512BW__)
+	static constexpr size_t width = 64;
+#elif defined(__AVX2__)
+	static constexpr size_t width = 32;
+#else
+	static constexpr size_t width = 16;
+#endif
+	typedef u8 Vec __attribute__((vector_size(width)));
+	typedef u16 Vec16 __attribute__((vector_size(2 * width)));
+
+	/* The registers of width lanes.
+	 * r is indexed like the r operands of the CPU, with F in place of (HL):
+	 * B, C, D, E, H, L, F, A.
+	 */
+	struct Group {
+		Vec r[8];
+		Vec16 SP;
+	};
+
+	static constexpr u8 rF = 6;
+	static constexpr u8 rA = 7;
+
+	std::vector<std::unique_ptr<Emulator>> lanes_;
+	std::vector<Group> groups_;
+	std::vector<Vec> val_; // (HL) operands, one vector per group
+
+	/* Shared by all lanes while in lockstep */
+	u16 PC_ = 0;
+	u64 cycles_ = 0;
+	u64 next_ = 0; // earliest event of any lane
+
+	/* Pages known to hold the same bytes in every lane or not, and the
+	 * page generations they were compared at, see Memory::page_gen().
+	 */
+	std::bitset<256> same_;
+	std::bitset<256> apart_;
+	std::vector<std::array<u32, 256>> gens_;
+	std::vector<u32> code_gen_;
+
+	u64 shared_ = 0;
+	u64 alone_ = 0;
+
+	[[nodiscard]] bool gather();
+	void scatter();
+	[[nodiscard]] bool step();
+	void step_alone(const std::vector<u64> &end);
+
+	[[nodiscard]] bool same_code(u16 addr, u8 len);
+	void accessed();
+
+	[[nodiscard]] u8 get(size_t lane, u8 r) { return groups_[lane / width].r[r][lane % width]; }
+	void set(size_t lane, u8 r, u8 val) { groups_[lane / width].r[r][lane % width] = val; }
+	[[nodiscard]] u16 pair(size_t lane, u8 hi) { return get(lane, hi) << 8 | get(lane, hi + 1); }
+
+	[[nodiscard]] Memory &bus(size_t lane);
+	[[nodiscard]] bool cond(u8 cc, size_t lane);
+	template <typename F> [[nodiscard]] int uniform(F f);
+
+	void load(u8 r, u8 hi); // r = (pair)
+	void store(u8 hi, u8 r); // (pair) = r
+	void inc16(u8 hi, bool down);
+	void push(u16 val);
+
+	/* The flag semantics of the CPU's instructions, on width lanes */
+	static void alu(u8 op, Vec &a, Vec &f, const Vec &b);
+	static void inc(Vec &v, Vec &f);
+	static void dec(Vec &v, Vec &f);
+	static void shift(u8 op, Vec &v, Vec &f);
+};
+
+} // namespace mboy
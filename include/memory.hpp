@@ -1,26 +1,184 @@
 #pragma once
 
+#include <array>
+#include <bitset>
+#include <memory>
+
 #include <common.hpp>
 
 namespace mboy {
 
+struct State;
+
 class Memory {
+	friend class Jit;
+
 public:
+	typedef u8 (*read_handler)(void *ctx, u16 addr);
+	typedef void (*write_handler)(void *ctx, u16 addr, u8 val);
+
+	struct Branch {};
+
 	Memory();
+	Memory(const Memory &) = delete;
+	Memory &operator=(const Memory &) = delete;
 	~Memory() = default;
 
-	u8 read(u16 addr) const;
-	void write(u16 addr, u8 val);
+	/* Copy-on-write branch
+	 * The new Memory shares every 256-byte page of internal RAM with other;
+	 * whichever of them writes to a shared page first copies it, through
+	 * the slow path that watched code pages take as well. A branch costs
+	 * the page table, a few kB, however often it is taken.
+	 * Only internal RAM and the boot ROM carry over: the bus starts out as
+	 * a new one would, the devices of the branch have to attach() to it
+	 * again. Emulator::branch() does all of that.
+	 */
+	Memory(Memory &other, Branch);
+
+	[[nodiscard]] u8 read(u16 addr) const
+	{
+		if (const u8 *p = read_[addr >> 8]) [[likely]]
+			return p[addr & 0xFF];
+		return slow_read(addr);
+	}
 
+	void write(u16 addr, u8 val)
+	{
+		if (u8 *p = write_[addr >> 8]) [[likely]] {
+			p[addr & 0xFF] = val;
+			return;
+		}
+		slow_write(addr, val);
+	}
+
+	/* The internal RAM behind addr, bypassing the page table.
+	 * Handlers keep the plain IO registers here.
+	 */
 	u8 &operator[](u16 addr);
 
+	/* Page table
+	 * Every 256-byte page has a read and a write pointer to the memory behind
+	 * it. Accesses to a page without a pointer go to the page's handlers:
+	 * IO registers have no pointers at all, ROM has no write pointer so its
+	 * writes reach the MBC. Mapping another bank only swaps the pointers.
+	 *
+	 * By default every page is internal RAM, 0xE000 - 0xFDFF mirrors
+	 * 0xC000 - 0xDDFF and page 0xFF is handled by io_read() and io_write(),
+	 * which keep everything in internal RAM. Until it is first written, a
+	 * RAM page is a page of zeros all instances share, so internal RAM
+	 * under cartridge banks or never used takes no memory.
+	 * At most a handful of distinct handlers can be installed.
+	 */
+	void map(u8 page, const u8 *read, u8 *write);
+	void handle(u8 page, read_handler read, write_handler write, void *ctx);
+
+	/* The page of addr reads as memory, not through handlers */
+	[[nodiscard]] bool plain(u16 addr) const { return read_[addr >> 8]; }
+
+	/* What a page reads as changed without a write to it, as when its
+	 * handlers serve another register: it counts as mapped again
+	 */
+	void changed(u8 page) { remapped(page); }
+
+	/* Default handlers of page 0xFF */
+	static u8 io_read(void *ctx, u16 addr);
+	static void io_write(void *ctx, u16 addr, u8 val);
+
+	/* Boot ROM
+	 * Mounting puts the 256 bytes at rom over page 0 for reads, until 0x01 is
+	 * written to 0xFF50. Whatever is mapped to page 0 meanwhile stays
+	 * underneath and shows up again once it is unmounted.
+	 */
+	void mount_boot(const u8 *rom);
+	void unmount_boot();
+	[[nodiscard]] bool booting() const { return boot_ != nullptr; }
+
+	/* Save states, see state.hpp
+	 * Given the marker of a mark() taken when s was last saved from this
+	 * Memory, save() only copies the pages written since.
+	 * Loading drops everything decoded from the bus and remounts the boot ROM
+	 * mounted last if the state was saved while booting.
+	 */
+	void save(State &s, u32 since = 0) const;
+	void load(const State &s);
+
+	/* Dirty pages
+	 * While tracking, each page remembers the last mark() before it was
+	 * written, so consumers holding a marker can ask which pages changed
+	 * since. A page not written since the last mark() has no write pointer:
+	 * its first write takes the slow path to record it, later ones are as
+	 * fast as without tracking. Mapping a page and operator[] count as
+	 * writes. Without tracking every page is dirty.
+	 */
+	void track_dirty(bool on);
+	[[nodiscard]] u32 mark();
+	[[nodiscard]] bool dirty(u8 page, u32 marker) const { return !tracking_ || written_[page] >= marker; }
+	[[nodiscard]] std::bitset<256> dirty_pages(u32 marker) const;
+
+	/* Code pages
+	 * The CPU decodes instructions ahead of time and watches the 256-byte
+	 * pages they were decoded from. A watched page has no write pointer, so
+	 * the first write to it takes the slow path, which bumps the page's
+	 * generation, telling the CPU that its decoded copy is stale, and bumps
+	 * code_gen() so a running block notices it wrote its own code. Mapping
+	 * a page bumps its generation as well.
+	 * watch_data() is the same for data decoded ahead of time, the PPU's
+	 * tiles: the first write only bumps the page's generation, code_gen()
+	 * and with it running blocks and chained JIT code are left alone.
+	 * Writes through operator[] are not seen.
+	 */
+	void watch_code(u16 addr);
+	void watch_data(u16 addr);
+	u32 page_gen(u16 addr) const { return page_gen_[addr >> 8]; }
+	u32 code_gen() const { return code_gen_; }
 
 private:
-	u8 mem[64 kB];
-};
+	struct Handler {
+		read_handler read_;
+		write_handler write_;
+		void *ctx_;
+	};
 
+	using Page = std::array<u8, 256>;
 
-} /* namespace */
+	// few devices handle pages, each page has the index of its handlers
+	static constexpr unsigned max_handlers = 8;
+
+	const u8 *read_[256];
+	u8 *write_[256]; // nullptr while watched
+	u8 *writable_[256]; // write pointer as mapped
+	Handler handlers_[max_handlers] = {}; // the first handles nothing
+	u8 handler_[256] = {};
+	u8 alias_[256]; // page sharing the same memory, the page itself if none
+
+	const u8 *boot_ = nullptr; // mounted boot ROM
+	const u8 *boot_under_ = nullptr; // read pointer of page 0 while mounted
+	const u8 *boot_rom_ = nullptr; // mounted last
 
+	// internal RAM, echo pages use the ones they mirror
+	std::shared_ptr<Page> ram_[256];
+	std::bitset<256> shared_; // maps a RAM page a branch or zero_page() may share, no write pointer
 
+	bool tracking_ = false;
+	u32 epoch_ = 1; // number of the last mark()
+	u32 written_[256] = {}; // epoch of the last write
 
+	std::bitset<256> watched_;
+	std::bitset<256> data_watched_;
+	u32 page_gen_[256] = {};
+	u32 code_gen_ = 0;
+
+	[[nodiscard]] u8 slow_read(u16 addr) const;
+	void slow_write(u16 addr, u8 val);
+	void invalidate(u8 page);
+	void remapped(u8 page);
+	[[nodiscard]] const u8 *&read_slot(u8 page);
+	void own(u8 real);
+	void update_write(u8 page);
+	void dirtied(u8 page);
+	[[nodiscard]] static const std::shared_ptr<Page> &zero_page();
+	[[nodiscard]] static constexpr u8 ram_page(u8 page) { return page >= 0xE0 && page < 0xFE ? page - 0x20 : page; }
+};
+
+
+} /* namespace */
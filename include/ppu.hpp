@@ -0,0 +1,157 @@
+#pragma once
+
+#include <array>
+
+#include <common.hpp>
+#include <memory.hpp>
+
+namespace mboy
+{
+class FrameRing;
+struct State;
+
+/* LCD controller (0xFF40 - 0xFF4B)
+ *
+ * Like the Timer, the PPU is not ticked with every instruction. A line takes
+ * 114 M-cycles: OAM search (mode 2) for 20, pixel transfer (mode 3) for 43
+ * and HBlank (mode 0) for the rest. Lines 144 - 153 are VBlank (mode 1).
+ * LY, the mode in STAT and the VBlank and STAT interrupts only change at
+ * these boundaries, update() passes the ones up to now. Each visible line
+ * is rendered as a whole when its pixel transfer ends, from the registers
+ * and VRAM as they are at that point.
+ *
+ * Not every boundary is an event: the Scheduler only wakes the PPU where it
+ * acts, at the end of each pixel transfer, at VBlank, at the first line,
+ * and where an enabled STAT interrupt source may fire, see next_event().
+ * Reading LY or STAT brings it up to date in between.
+ *
+ * Only STAT and LY are kept here, the other registers stay in the IO page
+ * of the bus as written. VRAM and OAM can be accessed in every mode and
+ * OAM DMA copies all 160 bytes at once.
+ *
+ * The 384 tiles at 0x8000 - 0x97FF are kept decoded, a colour number per
+ * pixel, so drawing a line is copying rows and mapping them through the
+ * palette. The PPU watches the VRAM pages, see Memory::watch_data(), and
+ * decodes the 16 tiles of a page again once it was written. Decoding and
+ * the palette are vectorised, see kernels.hpp.
+ */
+class PPU {
+    public:
+	static constexpr unsigned width = 160;
+	static constexpr unsigned height = 144;
+	static constexpr u64 line_cycles = 114;
+	static constexpr unsigned lines = 154;
+
+	static constexpr u16 LCDC = 0xFF40;
+	static constexpr u16 STAT = 0xFF41;
+	static constexpr u16 SCY = 0xFF42;
+	static constexpr u16 SCX = 0xFF43;
+	static constexpr u16 LY = 0xFF44;
+	static constexpr u16 LYC = 0xFF45;
+	static constexpr u16 DMA = 0xFF46;
+	static constexpr u16 BGP = 0xFF47;
+	static constexpr u16 OBP0 = 0xFF48;
+	static constexpr u16 OBP1 = 0xFF49;
+	static constexpr u16 WY = 0xFF4A;
+	static constexpr u16 WX = 0xFF4B;
+
+	/* Render from VRAM and OAM on m, with the registers in its IO page */
+	void attach(Memory *m);
+
+	/* STAT or LY */
+	[[nodiscard]] u8 read(u16 addr);
+
+	/* React to a write of val to LCDC, STAT, LYC or DMA, after the bus has
+	 * stored it. The caller has to update() first. Returns the interrupts
+	 * to request, see CPU::Interrupt.
+	 */
+	[[nodiscard]] u8 write(u16 addr, u8 val, u64 now);
+
+	/* Pass every mode boundary up to now, returns the interrupts to request */
+	[[nodiscard]] u8 update(u64 now);
+
+	/* Cycle of the next mode boundary, Scheduler::never while the LCD is off.
+	 * LY and STAT change there, whatever next_event() says.
+	 */
+	[[nodiscard]] u64 next_boundary() const;
+
+	/* Cycle of the next boundary the PPU has to act at.
+	 * It depends on the machine only, not on frame skipping, so save states
+	 * do not either.
+	 */
+	[[nodiscard]] u64 next_event();
+
+	/* Frame skipping
+	 * Draw a frame, then leave the next n undrawn, never_draw draws none.
+	 * It is decided as each frame starts, so setting it between frames
+	 * switches frame by frame. An undrawn frame keeps its exact timing, LY,
+	 * STAT and interrupts, it only lacks the pixels: frame() still shows the
+	 * last frame drawn.
+	 */
+	static constexpr u32 never_draw = ~0u;
+	void skip_frames(u32 n) { skip_ = n; }
+
+	/* The current frame is drawn */
+	[[nodiscard]] bool drawing() const { return draw_; }
+
+	/* Publish each frame drawn to ring at its VBlank, none if nullptr.
+	 * Undrawn frames are not published, see skip_frames().
+	 */
+	void publish_to(FrameRing *ring) { ring_ = ring; }
+
+	/* width x height shades from 0 (white) to 3 (black), line by line */
+	[[nodiscard]] const u8 *frame() const { return frame_.data(); }
+
+	/* VBlanks since power-on */
+	[[nodiscard]] u64 frames() const { return frames_; }
+
+	/* Save states, see state.hpp */
+	void save(State &s) const;
+	void load(const State &s);
+
+    private:
+	enum Mode : u8 {
+		hblank,
+		vblank,
+		oam_search,
+		transfer,
+	};
+
+	Memory *mem_ = nullptr;
+
+	u64 line_start_ = 0; // cycle at which line ly_ began
+	u64 frames_ = 0;
+	u8 ly_ = 0;
+	u8 mode_ = hblank;
+	u8 window_line_ = 0; // line of the window drawn next
+	bool stat_line_ = false; // the STAT interrupt sources, ORed
+	bool on_ = false; // LCDC bit 7 as last written
+
+	// up to the host, not part of save states
+	u32 skip_ = 0;
+	u32 skipped_ = 0; // frames left undrawn since the last one drawn
+	bool draw_ = true;
+	FrameRing *ring_ = nullptr;
+
+	std::array<u8, width * height> frame_ = {};
+
+	static constexpr unsigned tiles = 384;
+	static constexpr unsigned tile_pages = tiles * 16 / 256;
+
+	std::array<std::array<u8, 64>, tiles> tile_ = {}; // 8 rows of 8 pixels each, back to back
+	u32 tile_gen_[tile_pages] = {}; // generation the page was decoded at
+
+	static_assert(sizeof(tile_) == tiles * 64, "a page of tiles is decoded in one go");
+
+	[[nodiscard]] u8 io(u16 addr) { return (*mem_)[addr]; }
+	[[nodiscard]] u8 check_stat(u8 stat, u8 lyc);
+	[[nodiscard]] bool acts(u8 ly, u8 mode, u8 stat, u8 lyc) const;
+	static u64 step(u8 &ly, u8 &mode, u64 &start);
+	void start_frame();
+	[[nodiscard]] bool window_on_line();
+	void render();
+	void decode_tiles();
+	void draw_tiles(u8 *line, u16 map, u8 x, u8 y, unsigned from);
+};
+
+} // namespace mboy
@@ -0,0 +1,58 @@
+#pragma once
+
+#include <bitset>
+#include <cstddef>
+#include <memory>
+#include <vector>
+
+#include <common.hpp>
+#include <state.hpp>
+
+namespace mboy
+{
+/* The last frames of emulation, to step back through.
+ *
+ * Only the newest frame is kept as a whole State. Every older one is the
+ * XOR of it and its successor, run-length encoded in 64-bit words: a word
+ * holding the number of unchanged words (upper half) and of changed words
+ * (lower half), followed by the changed words. Consecutive frames differ in
+ * a few pages of RAM and some registers, so a delta takes a few hundred
+ * bytes. push() only reads both states once and writes the words that
+ * changed; the buffers are reused once the ring is full.
+ *
+ * All frames have to come from the same cartridge; a frame of another size
+ * starts the ring over.
+ */
+class Rewind {
+    public:
+	/* Keep up to frames frames, at least one */
+	explicit Rewind(size_t frames);
+
+	/* Remember s as the newest frame, dropping the oldest if full.
+	 * Pages of State::mem not in mem_pages are taken as unchanged since the
+	 * last push() without looking at them, see Memory::dirty_pages().
+	 */
+	void push(const State &s);
+	void push(const State &s, const std::bitset<256> &mem_pages);
+
+	/* Take the newest frame out into s, false if there is none */
+	bool pop(State &s);
+
+	void clear() { have_ = false; count_ = 0; }
+
+	[[nodiscard]] size_t frames() const { return have_ ? count_ + 1 : 0; }
+
+	/* Memory held by the frames */
+	[[nodiscard]] size_t bytes() const;
+
+    private:
+	std::unique_ptr<State> newest_ = std::make_unique<State>();
+	size_t size_ = 0; // bytes of newest_ in use
+	bool have_ = false;
+
+	std::vector<std::vector<u64>> deltas_; // ring, each turns a frame into its predecessor
+	size_t head_ = 0; // slot the next delta goes to
+	size_t count_ = 0;
+};
+
+} // namespace mboy
@@ -0,0 +1,84 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include <common.hpp>
+#include <emulator.hpp>
+
+namespace mboy
+{
+/* A pool of threads that steps many tasks, typically emulators, to the end.
+ *
+ * A task is stepped in short slices until it reports that it is done. Each
+ * thread keeps its tasks in a deque of its own, takes the next slice from
+ * the back, where the task it just ran goes again, and once it has nothing
+ * left steals from the front of another thread's deque. So tasks that take
+ * longer, a ROM that is slower to emulate, end up spread over the threads
+ * that would otherwise wait. A thread that finds nothing to steal, as the
+ * last tasks run elsewhere, sleeps until one of them is queued again or
+ * all are done.
+ *
+ * The calling thread works along during run(), which returns when all tasks
+ * are done. An exception thrown by a slice stops the run and is rethrown
+ * by run().
+ */
+class Runner {
+    public:
+	/* threads is the total including the caller, 0 for one per core */
+	explicit Runner(unsigned threads = 0);
+	~Runner();
+	Runner(const Runner &) = delete;
+	Runner &operator=(const Runner &) = delete;
+
+	/* Call step(i) for every task i < tasks until it returns false.
+	 * step is called from several threads at once, never twice at once with
+	 * the same i.
+	 */
+	void run(size_t tasks, const std::function<bool(size_t)> &step);
+
+	/* Run every emulator for cycles M-cycles, slice cycles at a time */
+	void run_for(const std::vector<Emulator *> &emus, u64 cycles, u64 slice = Emulator::frame_cycles);
+
+	[[nodiscard]] unsigned threads() const { return queues_.size(); }
+
+    private:
+	struct Queue {
+		std::mutex lock_;
+		std::deque<size_t> tasks_;
+	};
+
+	std::vector<std::unique_ptr<Queue>> queues_; // one per thread, the caller's first
+	std::vector<std::thread> threads_;
+
+	std::mutex lock_;
+	std::condition_variable start_;
+	std::condition_variable done_;
+	std::condition_variable queued_; // a task went back to a queue, or all are done
+	std::atomic<unsigned> idle_ = 0; // threads waiting for queued_
+	u64 requeued_ = 0; // number of wake()s, what idle threads wait for
+	u64 batch_ = 0; // number of the current run()
+	unsigned busy_ = 0; // helper threads still in the current run()
+	bool quit_ = false;
+
+	const std::function<bool(size_t)> *step_ = nullptr;
+	std::atomic<size_t> left_; // tasks not done yet
+	std::atomic<bool> failed_;
+	std::exception_ptr error_;
+
+	void helper(unsigned self);
+	void work(unsigned self);
+	[[nodiscard]] bool take(unsigned self, size_t &task);
+	[[nodiscard]] bool wait_for_task(unsigned self, size_t &task);
+	void wake();
+};
+
+} // namespace mboy
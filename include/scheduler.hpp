@@ -0,0 +1,48 @@
+#pragma once
+
+#include <algorithm>
+
+#include <common.hpp>
+
+namespace mboy
+{
+/* Points in emulated time, in M-cycles, at which something has to happen.
+ *
+ * Peripherals are not ticked along with every instruction. They are brought
+ * up to date when they are accessed and announce the next cycle at which
+ * they act on their own, e.g. a timer overflow. CPU::run_for() runs
+ * instructions until the earliest event is due, and a halted CPU skips
+ * straight to it.
+ */
+class Scheduler {
+	friend class Jit;
+
+    public:
+	enum Event : u8 {
+		timer, // TIMA overflow
+		irq, // IF, IE or IME changed, check for interrupts
+		ppu, // LCD mode boundary
+		num_events,
+	};
+
+	static constexpr u64 never = ~0ull;
+
+	void schedule(Event e, u64 when)
+	{
+		when_[e] = when;
+		next_ = *std::min_element(when_, when_ + num_events);
+	}
+
+	void cancel(Event e) { schedule(e, never); }
+
+	[[nodiscard]] bool due(Event e, u64 now) const { return when_[e] <= now; }
+
+	/* Cycle of the earliest event */
+	[[nodiscard]] u64 next() const { return next_; }
+
+    private:
+	u64 when_[num_events] = {never, never, never};
+	u64 next_ = never;
+};
+
+} // namespace mboy
@@ -0,0 +1,85 @@
+#pragma once
+
+#include <cstddef>
+#include <type_traits>
+
+#include <common.hpp>
+#include <scheduler.hpp>
+#include <timer.hpp>
+
+namespace mboy
+{
+/* A save state.
+ *
+ * Everything a running machine needs, in one flat block without pointers,
+ * so capturing and restoring are plain copies of its parts and the format
+ * is the struct itself, in host byte order. The cartridge RAM comes last:
+ * only the first size() bytes are in use, which is what goes to a file.
+ *
+ * CPU::save() fills in the header, the CPU and the bus, PPU::save() the
+ * LCD timing and Cartridge::save() the MBC and its RAM. Loading checks magic
+ * and version first, a state of another version is rejected rather than
+ * converted. Bump version whenever the layout changes.
+ * The framebuffer is not part of it, the next frame draws it anew.
+ *
+ * There is no padding anywhere, unused bytes are spelled out and stay 0, so
+ * equal machines give equal bytes to hash, compare and XOR.
+ */
+struct State {
+	static constexpr u32 magic = 0x594F424D; // "MBOY"
+	static constexpr u32 version = 4;
+	static constexpr size_t max_cart_ram = 128 kB;
+
+	struct {
+		u32 magic;
+		u32 version;
+		u32 cart_ram_size;
+		u32 unused;
+	} header;
+
+	struct {
+		u64 cycles;
+		u16 AF, BC, DE, HL, SP, PC;
+		bool halt, stop, ime;
+		u8 unused;
+	} cpu;
+
+	Scheduler sched;
+	Timer timer;
+
+	struct {
+		u64 line_start;
+		u8 ly;
+		u8 mode;
+		u8 window_line;
+		bool stat_line;
+		bool on;
+		u8 unused[3];
+	} ppu;
+
+	struct {
+		u16 rom_bank;
+		u8 ram_bank;
+		bool ram_enabled;
+		bool mode;
+		u8 rtc[5];
+		u8 latch;
+		u8 unused;
+	} cart;
+
+	bool booting; // boot ROM still mounted
+	u8 unused[131]; // up to the page aligned mem
+	alignas(256) u8 mem[64 kB]; // internal RAM, IO registers included
+	u8 cart_ram[max_cart_ram];
+
+	/* Bytes in use */
+	[[nodiscard]] size_t size() const
+	{
+		return cart_ram - reinterpret_cast<const u8 *>(this) + header.cart_ram_size;
+	}
+};
+
+static_assert(std::is_trivially_copyable_v<State>);
+static_assert(std::has_unique_object_representations_v<State>);
+
+} // namespace mboy
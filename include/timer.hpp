@@ -0,0 +1,44 @@
+#pragma once
+
+#include <common.hpp>
+#include <scheduler.hpp>
+
+namespace mboy
+{
+/* DIV, TIMA, TMA and TAC (0xFF04 - 0xFF07)
+ *
+ * DIV is the upper byte of a 16-bit counter running at the clock rate; TIMA
+ * counts the falling edges of one of its bits, selected by TAC. Nothing is
+ * counted per instruction: both are derived from the cycle counter whenever
+ * they are read, and next_overflow() tells the Scheduler when TIMA wraps.
+ */
+class Timer {
+    public:
+	[[nodiscard]] u8 read(u16 addr, u64 now);
+	void write(u16 addr, u8 val, u64 now);
+
+	/* Set the 16-bit counter behind DIV to value at now, as if it had been
+	 * counting up to it. The caller has to update() first.
+	 */
+	void set_counter(u16 value, u64 now);
+
+	/* Bring TIMA up to now, returns true if it overflowed since the last update */
+	bool update(u64 now);
+
+	/* Cycle at which TIMA overflows next, Scheduler::never while it is stopped */
+	[[nodiscard]] u64 next_overflow() const;
+
+    private:
+	u64 div_base_ = 0; // cycle at which the counter was 0
+	u64 tima_base_ = 0; // cycle up to which TIMA is counted
+	u8 tima_ = 0;
+	u8 tma_ = 0;
+	u8 tac_ = 0;
+	u8 unused_[5] = {}; // no padding in save states
+
+	[[nodiscard]] bool enabled() const { return tac_ & 0x04; }
+	[[nodiscard]] u64 period() const; // M-cycles per TIMA increment
+	[[nodiscard]] u64 edges(u64 now) const; // TIMA increments from div_base_ to now
+};
+
+} // namespace mboy
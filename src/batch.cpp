@@ -0,0 +1,248 @@
+#include <batch.hpp>
+#include <state.hpp>
+
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <mutex>
+#include <sstream>
+#include <stdexcept>
+
+namespace mboy
+{
+static std::string json_string(const std::string &s)
+{
+	std::string out = "\"";
+
+	for (char c : s) {
+		if (c == '"' || c == '\\') {
+			out += '\\';
+			out += c;
+		} else if (static_cast<unsigned char>(c) < 0x20) {
+			char buf[8];
+			snprintf(buf, sizeof(buf), "\\u%04x", c);
+			out += buf;
+		} else {
+			out += c;
+		}
+	}
+	return out + "\"";
+}
+
+/* FNV-1a, 64 bits */
+static u64 hash(const u8 *p, size_t n)
+{
+	u64 h = 0xCBF29CE484222325;
+
+	for (size_t i = 0; i < n; i++)
+		h = (h ^ p[i]) * 0x100000001B3;
+	return h;
+}
+
+Batch::Batch(const std::string &path)
+{
+	std::ifstream in(path);
+	if (!in)
+		throw std::runtime_error(path + ": cannot open");
+
+	std::string line;
+	for (unsigned n = 1; std::getline(in, line); n++) {
+		std::istringstream fields(line.substr(0, line.find('#')));
+		std::string word;
+		Job job;
+
+		if (!(fields >> job.rom))
+			continue;
+		if (!(fields >> job.frames))
+			throw std::runtime_error(path + ":" + std::to_string(n) + ": frame count missing");
+
+		while (fields >> word) {
+			std::string key = word.substr(0, word.find('='));
+			std::string val = word.find('=') != std::string::npos ? word.substr(word.find('=') + 1) : "";
+
+			if (word == "skip-boot")
+				job.skip_boot = true;
+			else if (word == "hash")
+				job.hash = true;
+			else if (word == "check")
+				job.check = true;
+			else if (key == "input" && !val.empty())
+				job.input = val;
+			else if (key == "state" && !val.empty())
+				job.state = val;
+			else if (key == "screenshot" && !val.empty())
+				job.screenshot = val;
+			else if (key == "ring" && !val.empty())
+				job.ring = val;
+			else if (key == "format" && !val.empty())
+				job.format = FrameRing::format(val);
+			else
+				throw std::runtime_error(path + ":" + std::to_string(n) + ": unknown option " + word);
+		}
+		jobs_.push_back(std::move(job));
+	}
+}
+
+std::vector<std::pair<u64, u8>> Batch::read_input(const std::string &path)
+{
+	std::ifstream in(path);
+	if (!in)
+		throw std::runtime_error(path + ": cannot open");
+
+	std::vector<std::pair<u64, u8>> buttons;
+	std::string line;
+	for (unsigned n = 1; std::getline(in, line); n++) {
+		std::istringstream fields(line.substr(0, line.find('#')));
+		u64 frame;
+		unsigned mask;
+
+		if (!(fields >> frame))
+			continue;
+		if (!(fields >> std::hex >> mask) || mask > 0xFF)
+			throw std::runtime_error(path + ":" + std::to_string(n) + ": expected <frame> <buttons>");
+		if (!buttons.empty() && frame < buttons.back().first)
+			throw std::runtime_error(path + ":" + std::to_string(n) + ": frames out of order");
+		buttons.emplace_back(frame, mask);
+	}
+	return buttons;
+}
+
+size_t Batch::run(Runner &runner, std::ostream &out)
+{
+	std::mutex lock;
+	size_t failed = 0;
+
+	runner.run(jobs_.size(), [&](size_t i) {
+		Job &job = jobs_[i];
+
+		try {
+			if (!job.emu)
+				start(job);
+
+			CPU &cpu = job.emu->cpu();
+			for (u64 n = 0; n < slice_frames && job.frame < job.frames; n++, job.frame++) {
+				// a ring needs every frame, a screenshot only the last ones
+				bool draw = job.frame_ring || (!job.screenshot.empty() && job.frame + 2 >= job.frames);
+				job.emu->ppu().skip_frames(draw ? 0 : PPU::never_draw);
+
+				while (job.next_buttons < job.buttons.size() && job.buttons[job.next_buttons].first <= job.frame) {
+					u8 buttons = job.buttons[job.next_buttons++].second;
+					cpu.set_buttons(buttons);
+					if (job.reference)
+						job.reference->cpu().set_buttons(buttons);
+				}
+
+				// frames start at fixed cycles, however much the last one overshot
+				u64 end = (job.frame + 1) * Emulator::frame_cycles;
+				if (cpu.cycles < end)
+					job.emu->run_for(end - cpu.cycles);
+				if (job.reference)
+					compare(job);
+			}
+			if (job.frame < job.frames)
+				return true;
+
+			finish(job);
+		} catch (const std::exception &e) {
+			job.error = e.what();
+		}
+		job.emu.reset();
+		job.reference.reset();
+		job.frame_ring.reset();
+
+		std::string line = "{\"job\":" + std::to_string(i) + ",\"rom\":" + json_string(job.rom) +
+				   ",\"frames\":" + std::to_string(job.frames);
+		if (job.error.empty())
+			line += job.result + ",\"ok\":true}";
+		else
+			line += ",\"ok\":false,\"error\":" + json_string(job.error) + "}";
+
+		std::lock_guard<std::mutex> l(lock);
+		out << line << std::endl;
+		failed += !job.error.empty();
+		return false;
+	});
+	return failed;
+}
+
+void Batch::start(Job &job)
+{
+	if (!job.input.empty())
+		job.buttons = read_input(job.input);
+	job.emu = std::make_unique<Emulator>(job.rom, job.skip_boot);
+	if (!job.ring.empty()) {
+		job.frame_ring = std::make_unique<FrameRing>(job.ring, job.format);
+		job.emu->ppu().publish_to(job.frame_ring.get());
+	}
+	if (job.check) {
+		job.reference = std::make_unique<Emulator>(job.rom, job.skip_boot);
+		job.reference->ppu().skip_frames(PPU::never_draw);
+	}
+}
+
+/* Bring the reference to the cycle run_for() stopped at and compare */
+void Batch::compare(Job &job)
+{
+	CPU &cpu = job.emu->cpu();
+	CPU &ref = job.reference->cpu();
+
+	while (ref.cycles < cpu.cycles) {
+		ref.exec();
+		// exec() skips a halt to the next event, run_for() stops at its end
+		if (ref.halted() && (ref.cycles > cpu.cycles || ref.sched.next() == Scheduler::never))
+			ref.cycles = cpu.cycles;
+	}
+
+	std::unique_ptr<State> s = std::make_unique<State>();
+	std::unique_ptr<State> r = std::make_unique<State>();
+	job.emu->save(*s);
+	job.reference->save(*r);
+	if (ref.cycles != cpu.cycles || std::memcmp(s.get(), r.get(), s->size())) {
+		char pc[24];
+		snprintf(pc, sizeof(pc), "PC %04X and %04X", cpu.PC, ref.PC);
+		throw std::runtime_error("frame " + std::to_string(job.frame) + ": run_for() and exec() differ at cycle " +
+					 std::to_string(cpu.cycles) + ", " + pc);
+	}
+}
+
+void Batch::finish(Job &job)
+{
+	job.result = ",\"cycles\":" + std::to_string(job.emu->cpu().cycles);
+	if (job.frame_ring)
+		job.result += ",\"ring\":" + json_string(job.ring) +
+			      ",\"published\":" + std::to_string(job.frame_ring->published());
+
+	if (job.hash || !job.state.empty()) {
+		std::unique_ptr<State> s = std::make_unique<State>();
+		job.emu->save(*s);
+
+		if (job.hash) {
+			char buf[20];
+			snprintf(buf, sizeof(buf), "%016llx",
+				 static_cast<unsigned long long>(hash(reinterpret_cast<const u8 *>(s.get()), s->size())));
+			job.result += ",\"hash\":\"" + std::string(buf) + "\"";
+		}
+		if (!job.state.empty()) {
+			std::ofstream f(job.state, std::ios::binary);
+			if (!f.write(reinterpret_cast<const char *>(s.get()), s->size()))
+				throw std::runtime_error(job.state + ": cannot write");
+			job.result += ",\"state\":" + json_string(job.state);
+		}
+	}
+
+	if (!job.screenshot.empty()) {
+		static constexpr u8 grey[4] = {0xFF, 0xAA, 0x55, 0x00};
+		const u8 *frame = job.emu->ppu().frame();
+		std::string pgm = "P5\n" + std::to_string(PPU::width) + " " + std::to_string(PPU::height) + "\n255\n";
+
+		for (unsigned i = 0; i < PPU::width * PPU::height; i++)
+			pgm += static_cast<char>(grey[frame[i]]);
+
+		std::ofstream f(job.screenshot, std::ios::binary);
+		if (!f.write(pgm.data(), pgm.size()))
+			throw std::runtime_error(job.screenshot + ": cannot write");
+		job.result += ",\"screenshot\":" + json_string(job.screenshot);
+	}
+}
+
+} // namespace mboy
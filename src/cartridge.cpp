@@ -0,0 +1,287 @@
+#include <cartridge.hpp>
+#include <state.hpp>
+
+#include <algorithm>
+#include <cstring>
+#include <fcntl.h>
+#include <stdexcept>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace mboy
+{
+Cartridge::Cartridge(const std::string &path)
+{
+	int fd = open(path.c_str(), O_RDONLY);
+	if (fd < 0)
+		throw std::runtime_error(path + ": cannot open");
+
+	struct stat st;
+	if (fstat(fd, &st) < 0 || st.st_size < static_cast<off_t>(2 * rom_bank_size) ||
+	    st.st_size % rom_bank_size) {
+		close(fd);
+		throw std::runtime_error(path + ": not a ROM image");
+	}
+
+	void *p = mmap(nullptr, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+	close(fd);
+	if (p == MAP_FAILED)
+		throw std::runtime_error(path + ": cannot map");
+	rom_size_ = st.st_size;
+	// unmapped with the last branch
+	rom_map_ = std::shared_ptr<const u8>(static_cast<const u8 *>(p), [size = rom_size_](const u8 *rom) {
+		munmap(const_cast<u8 *>(rom), size);
+	});
+	rom_ = rom_map_.get();
+
+	try {
+		parse_header();
+	} catch (const std::runtime_error &e) {
+		throw std::runtime_error(path + ": " + e.what());
+	}
+}
+
+std::unique_ptr<Cartridge> Cartridge::branch()
+{
+	std::unique_ptr<Cartridge> c(new Cartridge(*this));
+
+	c->mem_ = nullptr;
+	// the RAM is shared now, this one's pages lose their write pointers
+	if (mem_)
+		remap();
+	return c;
+}
+
+/* 0x0134 - 0x014F */
+void Cartridge::parse_header()
+{
+	static constexpr size_t ram_sizes[6] = {0, 2 kB, 8 kB, 32 kB, 128 kB, 64 kB};
+
+	for (u16 addr = 0x134; addr < 0x144 && rom_[addr]; addr++)
+		title_ += static_cast<char>(rom_[addr]);
+
+	switch (rom_[0x147]) {
+	case 0x00: case 0x08: case 0x09: // ROM (+RAM +BATTERY)
+		mbc_ = Mbc::none;
+		ram_enabled_ = true;
+		break;
+	case 0x01: case 0x02: case 0x03:
+		mbc_ = Mbc::mbc1;
+		break;
+	case 0x05: case 0x06:
+		mbc_ = Mbc::mbc2;
+		break;
+	case 0x0F: case 0x10: case 0x11: case 0x12: case 0x13:
+		mbc_ = Mbc::mbc3;
+		break;
+	case 0x19: case 0x1A: case 0x1B: case 0x1C: case 0x1D: case 0x1E:
+		mbc_ = Mbc::mbc5;
+		break;
+	default:
+		throw std::runtime_error("unsupported cartridge type " + std::to_string(rom_[0x147]));
+	}
+
+	if (mbc_ == Mbc::mbc2)
+		ram_->resize(512); // built in, 4 bits each
+	else if (rom_[0x149] < 6)
+		ram_->resize(ram_sizes[rom_[0x149]]);
+	static_assert(State::max_cart_ram >= ram_sizes[4]);
+}
+
+void Cartridge::attach(Memory *m)
+{
+	mem_ = m;
+	for (unsigned page = 0x00; page < 0x80; page++)
+		mem_->handle(page, nullptr, write_mbc, this);
+	for (unsigned page = 0xA0; page < 0xC0; page++)
+		mem_->handle(page, read_ram, write_ram, this);
+	remap();
+}
+
+const u8 *Cartridge::rom_bank(unsigned bank) const
+{
+	return rom_ + bank % (rom_size_ / rom_bank_size) * rom_bank_size;
+}
+
+/* Point the bus at the banks selected by the MBC registers.
+ * RAM which is disabled, not a whole bank or not plain memory (MBC2, the
+ * MBC3 clock) stays unmapped and goes through read_ram() and write_ram().
+ */
+void Cartridge::remap()
+{
+	unsigned bank0 = 0;
+	unsigned bank = 1;
+	unsigned ram_bank = 0;
+	bool ram_mapped = ram_enabled_ && ram_->size() >= ram_bank_size;
+
+	switch (mbc_) {
+	case Mbc::none:
+		break;
+	case Mbc::mbc1:
+		// a bank number of 0 in the lower 5 bits selects 1 instead
+		bank = (ram_bank_ & 0x03) << 5 | std::max(rom_bank_ & 0x1F, 1);
+		if (mode_) {
+			bank0 = (ram_bank_ & 0x03) << 5;
+			ram_bank = ram_bank_ & 0x03;
+		}
+		break;
+	case Mbc::mbc2:
+		bank = std::max(rom_bank_ & 0x0F, 1);
+		ram_mapped = false;
+		break;
+	case Mbc::mbc3:
+		bank = std::max(rom_bank_ & 0x7F, 1);
+		ram_bank = ram_bank_;
+		ram_mapped &= ram_bank_ < 0x08;
+		break;
+	case Mbc::mbc5:
+		bank = rom_bank_;
+		ram_bank = ram_bank_;
+		break;
+	}
+
+	for (unsigned page = 0x00; page < 0x40; page++)
+		mem_->map(page, rom_bank(bank0) + (page << 8), nullptr);
+	for (unsigned page = 0x40; page < 0x80; page++)
+		mem_->map(page, rom_bank(bank) + ((page - 0x40) << 8), nullptr);
+
+	// shared RAM is mapped for reads only, write_ram() copies it first
+	u8 *ram = ram_mapped ? &(*ram_)[ram_bank % (ram_->size() / ram_bank_size) * ram_bank_size] : nullptr;
+	ram_shared_ = ram_.use_count() > 1;
+	for (unsigned page = 0xA0; page < 0xC0; page++) {
+		u8 *p = ram ? ram + ((page - 0xA0) << 8) : nullptr;
+		mem_->map(page, p, ram_shared_ ? nullptr : p);
+	}
+
+	// the pages stay unmapped, but read_ram() may serve something else:
+	// 0xFF while disabled, the RAM or a clock register
+	u16 view = !ram_enabled_ ? 0xFFFF : mbc_ == Mbc::mbc3 && ram_bank_ >= 0x08 ? ram_bank_ : 0;
+	if (!ram && view != ram_view_)
+		ram_changed();
+	ram_view_ = view;
+}
+
+/* 0xA000 - 0xBFFF read as something else without a write to each page */
+void Cartridge::ram_changed()
+{
+	for (unsigned page = 0xA0; page < 0xC0; page++)
+		mem_->changed(page);
+}
+
+void Cartridge::save(State &s) const
+{
+	s.cart = {rom_bank_, ram_bank_, ram_enabled_, mode_, {}, latch_, 0};
+	std::memcpy(s.cart.rtc, rtc_, sizeof(rtc_));
+	s.header.cart_ram_size = ram_->size();
+	std::memcpy(s.cart_ram, ram_->data(), ram_->size());
+}
+
+void Cartridge::load(const State &s)
+{
+	if (s.header.cart_ram_size != ram_->size())
+		throw std::runtime_error("save state: cartridge RAM size does not match");
+
+	rom_bank_ = s.cart.rom_bank;
+	ram_bank_ = s.cart.ram_bank;
+	ram_enabled_ = s.cart.ram_enabled;
+	mode_ = s.cart.mode;
+	std::memcpy(rtc_, s.cart.rtc, sizeof(rtc_));
+	latch_ = s.cart.latch;
+	if (ram_.use_count() > 1)
+		ram_ = std::make_shared<std::vector<u8>>(*ram_);
+	std::memcpy(ram_->data(), s.cart_ram, ram_->size());
+	if (mem_)
+		remap();
+}
+
+/* Writes to 0x0000 - 0x7FFF */
+void Cartridge::write_mbc(void *ctx, u16 addr, u8 val)
+{
+	Cartridge *c = static_cast<Cartridge *>(ctx);
+
+	switch (c->mbc_) {
+	case Mbc::none:
+		return;
+	case Mbc::mbc2:
+		if (addr >= 0x4000)
+			return;
+		// address bit 8 tells the registers apart
+		if (addr & 0x100)
+			c->rom_bank_ = val & 0x0F;
+		else
+			c->ram_enabled_ = (val & 0x0F) == 0x0A;
+		break;
+	default:
+		switch (addr >> 13) {
+		case 0: // 0x0000 - 0x1FFF
+			c->ram_enabled_ = (val & 0x0F) == 0x0A;
+			break;
+		case 1: // 0x2000 - 0x3FFF
+			if (c->mbc_ == Mbc::mbc1)
+				c->rom_bank_ = val & 0x1F;
+			else if (c->mbc_ == Mbc::mbc3)
+				c->rom_bank_ = val & 0x7F;
+			else if (addr < 0x3000)
+				c->rom_bank_ = (c->rom_bank_ & 0x100) | val;
+			else
+				c->rom_bank_ = (c->rom_bank_ & 0xFF) | (val & 0x01) << 8;
+			break;
+		case 2: // 0x4000 - 0x5FFF
+			c->ram_bank_ = c->mbc_ == Mbc::mbc1 ? val & 0x03 : val & 0x0F;
+			break;
+		case 3: // 0x6000 - 0x7FFF
+			if (c->mbc_ == Mbc::mbc1)
+				c->mode_ = val & 0x01;
+			else if (c->mbc_ == Mbc::mbc3)
+				c->latch_ = val; // 0 then 1 latches the clock, which stands still
+			break;
+		}
+		break;
+	}
+	c->remap();
+}
+
+/* 0xA000 - 0xBFFF while it is not mapped */
+u8 Cartridge::read_ram(void *ctx, u16 addr)
+{
+	Cartridge *c = static_cast<Cartridge *>(ctx);
+
+	if (!c->ram_enabled_)
+		return 0xFF;
+	if (c->mbc_ == Mbc::mbc2)
+		return 0xF0 | (*c->ram_)[addr & 0x1FF];
+	if (c->mbc_ == Mbc::mbc3 && c->ram_bank_ >= 0x08)
+		return c->ram_bank_ <= 0x0C ? c->rtc_[c->ram_bank_ - 0x08] : 0xFF;
+	if (c->ram_->empty())
+		return 0xFF;
+	return (*c->ram_)[(addr - 0xA000) % c->ram_->size()];
+}
+
+void Cartridge::write_ram(void *ctx, u16 addr, u8 val)
+{
+	Cartridge *c = static_cast<Cartridge *>(ctx);
+
+	if (!c->ram_enabled_)
+		return;
+	// the first write since a branch: copy the RAM if it is still shared,
+	// map it writable again and write through the bus
+	if (c->ram_shared_) {
+		if (c->ram_.use_count() > 1)
+			c->ram_ = std::make_shared<std::vector<u8>>(*c->ram_);
+		c->remap();
+		c->mem_->write(addr, val);
+		return;
+	}
+	if (c->mbc_ == Mbc::mbc2)
+		(*c->ram_)[addr & 0x1FF] = val & 0x0F;
+	else if (c->mbc_ == Mbc::mbc3 && c->ram_bank_ >= 0x08) {
+		if (c->ram_bank_ <= 0x0C)
+			c->rtc_[c->ram_bank_ - 0x08] = val;
+	} else if (!c->ram_->empty())
+		(*c->ram_)[(addr - 0xA000) % c->ram_->size()] = val;
+	// served by read_ram(), the byte shows up on other pages too
+	c->ram_changed();
+}
+
+} // namespace mboy
@@ -1,37 +1,464 @@
 #include <cpu.hpp>
 #include <instruction.hpp>
-
+#include <ppu.hpp>
+#include <state.hpp>
+#ifdef MBOY_JIT
+#include <jit.hpp>
+#endif
+
+#include <algorithm>
+#include <bit>
 #include <iostream>
+#include <stdexcept>
+#include <utility>
 namespace mboy
 {
 #define EXT_OP 0xCB
 
-CPU::CPU() : PC(0x0), SP(0)
-{
-}
+CPU::CPU() : PC(0x0), SP(0) {}
 
-CPU::Instruction::Instruction()
+CPU::BlockCache::BlockCache()
 {
+#ifdef MBOY_JIT
+	jit_ = std::make_unique<Jit>();
+#endif
 }
-CPU::Instruction::Instruction(std::string name, u16 opcode, operation func, size_t num_args)
-	: name_(name), opcode_(opcode), func_(func), num_args_(num_args)
+
+CPU::BlockCache::BlockCache(const BlockCache &) : BlockCache() {}
+
+CPU::BlockCache &CPU::BlockCache::operator=(const BlockCache &)
 {
+	blocks_.clear();
+#ifdef MBOY_JIT
+	jit_ = std::make_unique<Jit>();
+#endif
+	return *this;
 }
+
+CPU::BlockCache::~BlockCache() = default;
+
 /* Execute next Instruction
  * This is basically the main function which the CPU should loop
  */
-u16 CPU::exec()
+u64 CPU::exec()
+{
+	u64 start = cycles;
+
+	if (cycles >= sched.next())
+		events();
+
+	if (halt_ || stop_) {
+		if (sched.next() != Scheduler::never)
+			cycles = sched.next();
+		return cycles - start;
+	}
+
+	run(decode(PC));
+	return cycles - start;
+}
+
+u64 CPU::run_for(u64 n)
+{
+	u64 start = cycles;
+	u64 end = start + n;
+
+	while (cycles < end) {
+		if (cycles >= sched.next())
+			events();
+
+		if (halt_ || stop_) {
+			// only an event can end it, skip straight to the next one
+			cycles = std::min(end, sched.next());
+			continue;
+		}
+
+		u16 start = PC;
+		Block *bp = block(PC);
+		if (!bp) {
+			run(decode(PC));
+			continue;
+		}
+		Block &b = *bp;
+#ifdef MBOY_JIT
+		if (!b.idle_cycles_ && cache_.jit_->run(*this, b, PC, std::min(end, sched.next())))
+			continue;
+#endif
+		u32 gen = mem->code_gen();
+
+		for (const DecodedOp &op : b.ops_) {
+			run(op);
+			// stop early for events and if the block overwrote code
+			if (cycles >= end || cycles >= sched.next() || mem->code_gen() != gen)
+				break;
+		}
+
+		if (b.idle_cycles_ && PC == start)
+			skip_idle(b, end);
+	}
+	return cycles - start;
+}
+
+/**************
+ * Interrupts *
+ **************/
+
+void CPU::request(u8 irq)
+{
+	write(IF, read(IF) | irq);
+}
+
+void CPU::set_buttons(u8 pressed)
+{
+	u8 p1 = (*mem)[P1];
+	u8 down = pressed & ~buttons_;
+
+	buttons_ = pressed;
+	if ((!(p1 & 0x10) && (down & 0x0F)) || (!(p1 & 0x20) && (down & 0xF0)))
+		request(int_joypad);
+}
+
+/* Handle the events which are due and take the highest priority interrupt */
+void CPU::events()
+{
+	if (sched.due(Scheduler::timer, cycles))
+		sync_timer();
+	if (sched.due(Scheduler::ppu, cycles))
+		sync_ppu();
+	sched.cancel(Scheduler::irq);
+
+	u8 pending = read(IF) & read(IE) & 0x1F;
+	if (!pending)
+		return;
+
+	halt_ = false;
+	stop_ = false;
+	if (!interruptable_)
+		return;
+
+	u8 irq = pending & -pending;
+	(*mem)[IF] &= ~irq;
+	interruptable_ = false;
+	push16(PC);
+	PC = 0x40 + 8 * std::countr_zero(irq);
+	cycles += 5;
+}
+
+/*******************************************************
+ * IO Registers
+ *
+ * The CPU handles page 0xFF of the bus: the timer, P1, the PPU if
+ * one is attached, and IF and IE, whose writes may make an interrupt due.
+ * Everything else goes to the default handlers of Memory.
+ *******************************************************/
+
+void CPU::attach(Memory *m)
+{
+	mem = m;
+	mem->handle(0xFF, io_read, io_write, this);
+}
+
+void CPU::attach(PPU *p)
+{
+	ppu = p;
+	ppu->attach(mem);
+	sched.schedule(Scheduler::ppu, ppu->next_event());
+}
+
+void CPU::skip_boot()
+{
+	static constexpr std::pair<u16, u8> io[] = {
+		{0xFF05, 0x00}, {0xFF06, 0x00}, {0xFF07, 0xF8}, {0xFF0F, 0xE1},
+		{0xFF10, 0x80}, {0xFF11, 0xBF}, {0xFF12, 0xF3}, {0xFF14, 0xBF},
+		{0xFF16, 0x3F}, {0xFF19, 0xBF}, {0xFF1A, 0x7F}, {0xFF1B, 0xFF},
+		{0xFF1C, 0x9F}, {0xFF1E, 0xBF}, {0xFF20, 0xFF}, {0xFF23, 0xBF},
+		{0xFF24, 0x77}, {0xFF25, 0xF3}, {0xFF26, 0xF1}, {0xFF40, 0x91},
+		{0xFF42, 0x00}, {0xFF43, 0x00}, {0xFF45, 0x00}, {0xFF47, 0xFC},
+		{0xFF48, 0xFF}, {0xFF49, 0xFF}, {0xFF4A, 0x00}, {0xFF4B, 0x00},
+		{0xFF50, 0x01}, {0xFFFF, 0x00},
+	};
+
+	for (auto [addr, val] : io)
+		write(addr, val);
+
+	// DIV reads 0xAB, the counter behind it is at 0xABCC
+	sync_timer();
+	timer.set_counter(0xABCC, cycles);
+	sched.schedule(Scheduler::timer, timer.next_overflow());
+
+	AF = 0x01B0;
+	BC = 0x0013;
+	DE = 0x00D8;
+	HL = 0x014D;
+	SP = 0xFFFE;
+	PC = 0x0100;
+	lazy_.op = FlagOp::none;
+	interruptable_ = false;
+	halt_ = stop_ = false;
+}
+
+u8 CPU::io_read(void *ctx, u16 addr)
+{
+	CPU *cpu = static_cast<CPU *>(ctx);
+
+	if (addr >= 0xFF04 && addr <= 0xFF07) {
+		cpu->sync_timer();
+		return cpu->timer.read(addr, cpu->cycles);
+	}
+	if (addr == P1) {
+		// a 0 in bit 4 selects the directions, in bit 5 the buttons
+		u8 p1 = Memory::io_read(cpu->mem, addr) | 0xCF;
+		if (!(p1 & 0x10))
+			p1 &= ~(cpu->buttons_ & 0x0F);
+		if (!(p1 & 0x20))
+			p1 &= ~(cpu->buttons_ >> 4);
+		return p1;
+	}
+	if (cpu->ppu && (addr == PPU::STAT || addr == PPU::LY)) {
+		cpu->sync_ppu();
+		return cpu->ppu->read(addr);
+	}
+	return Memory::io_read(cpu->mem, addr);
+}
+
+void CPU::io_write(void *ctx, u16 addr, u8 val)
+{
+	CPU *cpu = static_cast<CPU *>(ctx);
+
+	if (addr >= 0xFF04 && addr <= 0xFF07) {
+		cpu->sync_timer();
+		cpu->timer.write(addr, val, cpu->cycles);
+		cpu->sched.schedule(Scheduler::timer, cpu->timer.next_overflow());
+		return;
+	}
+	if (cpu->ppu && addr >= PPU::LCDC && addr <= PPU::WX) {
+		cpu->sync_ppu();
+		Memory::io_write(cpu->mem, addr, val);
+		if (u8 irq = cpu->ppu->write(addr, val, cpu->cycles))
+			cpu->request(irq);
+		cpu->sched.schedule(Scheduler::ppu, cpu->ppu->next_event());
+		return;
+	}
+	Memory::io_write(cpu->mem, addr, val);
+	if (addr == IF || addr == IE)
+		cpu->sched.schedule(Scheduler::irq, cpu->cycles);
+}
+
+/* Count TIMA up to now and schedule its next overflow */
+void CPU::sync_timer()
+{
+	if (timer.update(cycles))
+		request(int_timer);
+	sched.schedule(Scheduler::timer, timer.next_overflow());
+}
+
+/* Pass the LCD mode boundaries up to now and schedule the next one */
+void CPU::sync_ppu()
+{
+	if (u8 irq = ppu->update(cycles))
+		request(irq);
+	sched.schedule(Scheduler::ppu, ppu->next_event());
+}
+
+/***************
+ * Save States *
+ ***************/
+
+void CPU::save(State &s, u32 since)
+{
+	sync_flags();
+	s.header = {State::magic, State::version, 0, 0};
+	s.cpu = {cycles, AF, BC, DE, HL, SP, PC, halt_, stop_, interruptable_, 0};
+	s.sched = sched;
+	s.timer = timer;
+	mem->save(s, since);
+}
+
+void CPU::load(const State &s)
+{
+	if (s.header.magic != State::magic || s.header.version != State::version)
+		throw std::runtime_error("save state: unknown format");
+
+	AF = s.cpu.AF;
+	BC = s.cpu.BC;
+	DE = s.cpu.DE;
+	HL = s.cpu.HL;
+	SP = s.cpu.SP;
+	PC = s.cpu.PC;
+	lazy_.op = FlagOp::none;
+	halt_ = s.cpu.halt;
+	stop_ = s.cpu.stop;
+	interruptable_ = s.cpu.ime;
+	cycles = s.cpu.cycles;
+	sched = s.sched;
+	timer = s.timer;
+	mem->load(s);
+}
+
+/***************
+ * Block Cache *
+ ***************/
+
+/* Instructions after which execution does not simply continue with the next one */
+static constexpr bool ends_block(u8 op)
+{
+	switch (op) {
+	case 0x10: // STOP
+	case 0x76: // HALT
+	case 0x18: case 0x20: case 0x28: case 0x30: case 0x38: // JR
+	case 0xC2: case 0xC3: case 0xCA: case 0xD2: case 0xDA: case 0xE9: // JP
+	case 0xC4: case 0xCC: case 0xCD: case 0xD4: case 0xDC: // CALL
+	case 0xC0: case 0xC8: case 0xC9: case 0xD0: case 0xD8: case 0xD9: // RET
+		return true;
+	default:
+		return (op & 0xC7) == 0xC7; // RST
+	}
+}
+
+CPU::DecodedOp CPU::decode(u16 addr)
+{
+	DecodedOp d{};
+	u8 op = mem->read(addr);
+
+	if (op == EXT_OP) {
+		op = mem->read(addr + 1);
+		d.func_ = cb_ops[op];
+		d.cycles_ = cb_op_cycles[op];
+		d.opcode_len_ = 2;
+		d.len_ = 2;
+		return d;
+	}
+
+	d.func_ = ops[op];
+	d.cycles_ = op_cycles[op];
+	d.opcode_len_ = 1;
+	d.len_ = 1 + instructions[op].num_args_;
+	for (u8 i = 1; i < d.len_; i++)
+		d.imm_[i - 1] = mem->read(addr + i);
+	return d;
+}
+
+/* The block at addr, nullptr if addr is not on a page of plain memory.
+ * Handlers serve values no write to the page changes: IO registers count
+ * on their own, MBC2 RAM and the MBC3 clock depend on the MBC registers.
+ * Code there is never cached, a block ends before it.
+ */
+CPU::Block *CPU::block(u16 addr)
+{
+	if (!mem->plain(addr))
+		return nullptr;
+
+	Block &b = cache_.blocks_[addr];
+
+	if (!b.ops_.empty() && b.gen_[0] == mem->page_gen(addr) && b.gen_[1] == mem->page_gen(b.end_))
+		return &b;
+
+	u16 pc = addr;
+	bool last;
+
+	b.ops_.clear();
+	do {
+		last = ends_block(mem->read(pc));
+		DecodedOp d = decode(pc);
+		if (!mem->plain(pc + d.len_ - 1)) {
+			if (b.ops_.empty())
+				return nullptr;
+			break;
+		}
+		b.ops_.push_back(d);
+		pc += d.len_;
+	} while (!last && b.ops_.size() < max_block_len);
+
+	b.end_ = pc - 1;
+	mem->watch_code(addr);
+	mem->watch_code(b.end_);
+	b.gen_[0] = mem->page_gen(addr);
+	b.gen_[1] = mem->page_gen(b.end_);
+	b.idle_cycles_ = idle_cycles(addr, b);
+#ifdef MBOY_JIT
+	b.hits_ = 0;
+	b.max_cycles_ = 3; // taken CALL cc
+	for (const DecodedOp &op : b.ops_)
+		b.max_cycles_ += op.cycles_;
+	b.epoch_ = 0;
+	b.native_ = nullptr;
+	b.body_ = nullptr;
+#endif
+	return &b;
+}
+
+/* Cycles of one iteration if the block at addr is an idle loop: a load of A
+ * from memory, optionally a test of A, and a JR back to the load.
+ */
+u8 CPU::idle_cycles(u16 addr, const Block &b)
 {
-	CPU::Instruction i;
-	u16 op = read_pc();
+	u8 load = mem->read(addr);
+	u16 pc = addr + b.ops_[0].len_;
 
-	if (op == 0xCB) {
-		op <<= 8;
-		op |= read_pc();
+	switch (load) {
+	case 0x0A: case 0x1A: case 0x7E: // LD A,(BC), LD A,(DE), LD A,(HL)
+	case 0xF0: case 0xFA: // LDH A,(n), LD A,(nn)
+		break;
+	default:
+		return 0;
 	}
-	i = opcode[op];
-	(this->*i.func_)();
-	return op;
+
+	if (b.ops_.size() == 3) {
+		u8 test = mem->read(pc);
+		bool bit_a = test == EXT_OP && (mem->read(pc + 1) & 0xC7) == 0x47;
+		// CP n, AND n, AND A, OR A, BIT b,A
+		if (test != 0xFE && test != 0xE6 && test != 0xA7 && test != 0xB7 && !bit_a)
+			return 0;
+		pc += b.ops_[1].len_;
+	} else if (b.ops_.size() != 2) {
+		return 0;
+	}
+
+	u8 jr = mem->read(pc);
+	if ((jr != 0x18 && (jr & 0xE7) != 0x20) || pc + 2 + static_cast<i8>(mem->read(pc + 1)) != addr)
+		return 0;
+
+	// the cycles of JR cc assume it is not taken, those of JR already count it
+	u8 n = jr == 0x18 ? 0 : 1;
+	for (const DecodedOp &op : b.ops_)
+		n += op.cycles_;
+	return n;
+}
+
+/* Skip iterations of an idle loop which just returned to its start.
+ * The value it polls can only change through an event, so up to the next
+ * event every iteration repeats the last one. Only iterations the
+ * interpreter would have completed before the next event or the end are
+ * skipped, the rest runs as usual.
+ * DIV and TIMA count without events and are never skipped over, LY and
+ * STAT change at every mode boundary of the PPU, not just its events.
+ */
+void CPU::skip_idle(const Block &b, u64 end)
+{
+	u16 addr;
+	switch (mem->read(PC)) {
+	case 0x0A: addr = BC; break;
+	case 0x1A: addr = DE; break;
+	case 0x7E: addr = HL; break;
+	case 0xF0: addr = 0xFF00 | b.ops_[0].imm_[0]; break;
+	default: addr = b.ops_[0].imm_[0] | b.ops_[0].imm_[1] << 8; break;
+	}
+	if (addr >= 0xFF04 && addr <= 0xFF07)
+		return;
+
+	u64 until = std::min(end, sched.next());
+	if (ppu && (addr == PPU::LY || addr == PPU::STAT))
+		until = std::min(until, ppu->next_boundary());
+	if (until <= cycles)
+		return;
+	cycles += (until - cycles - 1) / b.idle_cycles_ * b.idle_cycles_;
+}
+
+inline void CPU::run(const DecodedOp &op)
+{
+	PC += op.opcode_len_;
+	imm_ = op.imm_;
+	cycles += op.cycles_;
+	(this->*op.func_)();
 }
 
 /************************************************
@@ -39,11 +466,11 @@ u16 CPU::exec()
  ************************************************/
 
 // Read Program Counter, 8-bit
+// The operands were fetched when the instruction was decoded
 [[nodiscard]] inline u8 CPU::read_pc()
 {
-	u8 val = mem->read(PC);
 	PC++;
-	return val;
+	return *imm_++;
 }
 
 // Read Program Counter, 16-bit
@@ -57,30 +484,28 @@ u16 CPU::exec()
 // Read Stack, 8-bit
 [[nodiscard]] inline u8 CPU::pop()
 {
-	SP++;
-	return mem->read(SP);
+	return read(SP++);
 }
 
 // Read Stack, 16-bit
 [[nodiscard]] inline u16 CPU::pop16()
 {
-	u16 val = pop() << 8;
-	val |= pop();
+	u16 val = pop();
+	val |= pop() << 8;
 	return val;
 }
 
 // Write Stack, 8-bit
 inline void CPU::push(u8 val)
 {
-	mem->write(SP, val);
-	SP--;
+	write(--SP, val);
 }
 
 // Write Stack, 16-bit
 inline void CPU::push16(u16 val)
 {
-	push(val & 0xFF);
 	push(val >> 8);
+	push(val & 0xFF);
 }
 
 // Read from arbitrary address, 8-bit
@@ -98,8 +523,87 @@ inline void CPU::write(u16 addr, u8 val)
 // Write to arbitrary address, 16-bit
 inline void CPU::write16(u16 addr, u16 val)
 {
-	mem->write(addr, val & 0xFF);
-	mem->write(addr + 1, val >> 8);
+	write(addr, val & 0xFF);
+	write(addr + 1, val >> 8);
+}
+
+/**************
+ * Lazy Flags *
+ **************/
+
+inline void CPU::set_flags(FlagOp op, u8 op1, u8 op2, u16 result, bool carry)
+{
+	lazy_.op = op;
+	lazy_.op1 = op1;
+	lazy_.op2 = op2;
+	lazy_.result = result;
+	lazy_.carry = carry;
+#ifndef MBOY_LAZY_FLAGS
+	sync_flags();
+#endif
+}
+
+[[nodiscard]] inline bool CPU::flag_z()
+{
+	if (lazy_.op == FlagOp::none)
+		return flags.z;
+	return (u8)lazy_.result == 0;
+}
+
+[[nodiscard]] inline bool CPU::flag_c()
+{
+	switch (lazy_.op) {
+	case FlagOp::none:
+		return flags.c;
+	case FlagOp::add:
+	case FlagOp::sub:
+		return lazy_.result & 0x100;
+	case FlagOp::logic_and:
+	case FlagOp::logic:
+		return false;
+	default: // inc, dec, shift and bit keep their carry in lazy_.carry
+		return lazy_.carry;
+	}
+}
+
+void CPU::sync_flags()
+{
+	bool n = false, h = false, c = lazy_.carry;
+
+	switch (lazy_.op) {
+	case FlagOp::none:
+		return;
+	case FlagOp::add:
+		h = (lazy_.op1 ^ lazy_.op2 ^ lazy_.result) & 0x10;
+		c = lazy_.result & 0x100;
+		break;
+	case FlagOp::sub:
+		n = true;
+		h = (lazy_.op1 ^ lazy_.op2 ^ lazy_.result) & 0x10;
+		c = lazy_.result & 0x100;
+		break;
+	case FlagOp::logic_and:
+		h = true;
+		c = false;
+		break;
+	case FlagOp::logic:
+		c = false;
+		break;
+	case FlagOp::inc:
+		h = (lazy_.result & 0x0F) == 0x00;
+		break;
+	case FlagOp::dec:
+		n = true;
+		h = (lazy_.result & 0x0F) == 0x0F;
+		break;
+	case FlagOp::shift:
+		break;
+	case FlagOp::bit:
+		h = true;
+		break;
+	}
+	F = ((u8)lazy_.result == 0) << 7 | n << 6 | h << 5 | c << 4;
+	lazy_.op = FlagOp::none;
 }
 
 /************************************************
@@ -109,26 +613,22 @@ inline void CPU::write16(u16 addr, u16 val)
 [[nodiscard]] inline u8 CPU::add8bit(u8 op1, u8 op2)
 {
 	u16 result = op1 + op2;
-	flags.c = 0x100 == ((op1 ^ op2 ^ result) & 0x100);
-	flags.h = 0x10 == ((op1 ^ op2 ^ result) & 0x10);
-	flags.z = result == 0;
-	flags.n = false;
+	set_flags(FlagOp::add, op1, op2, result, false);
 	return (u8)(result & 0xFF);
 }
 
 [[nodiscard]] inline u8 CPU::adc8bit(u8 op1, u8 op2)
 {
-	u16 result = op1 + op2 + flags.c;
-	flags.c = 0x100 == ((op1 ^ op2 ^ result) & 0x100);
-	flags.h = 0x10 == ((op1 ^ op2 ^ result) & 0x10);
-	flags.z = result == 0;
-	flags.n = false;
+	bool carry = flag_c();
+	u16 result = op1 + op2 + carry;
+	set_flags(FlagOp::add, op1, op2, result, carry);
 	return (u8)(result & 0xFF);
 }
 
 [[nodiscard]] inline u16 CPU::add16bit(u16 op1, u16 op2)
 {
 	u32 result = op1 + op2;
+	sync_flags();
 	flags.n = false;
 	flags.c = 0x1'00'00 == ((op1 ^ op2 ^ result) & 0x1'00'00);
 	flags.h = 0x10'00 == ((op1 ^ op2 ^ result) & 0x10'00);
@@ -137,67 +637,52 @@ inline void CPU::write16(u16 addr, u16 val)
 
 [[nodiscard]] inline u8 CPU::sub8bit(u8 op1, u8 op2)
 {
-	flags.c = op1 < op2;
-	flags.h = (op1 & 0x0F) < (op2 & 0x0F);
-	flags.z = op1 == op2;
-	flags.n = true;
-	return (u8)(op1 - op2);
+	u16 result = op1 - op2;
+	set_flags(FlagOp::sub, op1, op2, result, false);
+	return (u8)(result & 0xFF);
 }
 
 [[nodiscard]] inline u8 CPU::sbc8bit(u8 op1, u8 op2)
 {
-	op2 = op2 + flags.c;
-	flags.c = op1 < op2;
-	flags.h = (op1 & 0x0F) < (op2 & 0x0F);
-	flags.z = op1 == op2;
-	flags.n = true;
-	return (u8)(op1 - op2);
+	bool carry = flag_c();
+	u16 result = op1 - op2 - carry;
+	set_flags(FlagOp::sub, op1, op2, result, carry);
+	return (u8)(result & 0xFF);
 }
 
 [[nodiscard]] inline u8 CPU::and8bit(u8 op1, u8 op2)
 {
 	u8 result = op1 & op2;
-	flags.z = result == 0;
-	flags.n = false;
-	flags.h = true;
-	flags.c = false;
+	set_flags(FlagOp::logic_and, op1, op2, result, false);
 	return result;
 };
 
 [[nodiscard]] inline u8 CPU::or8bit(u8 op1, u8 op2)
 {
 	u8 result = op1 | op2;
-	flags.z = result == 0;
-	flags.n = false;
-	flags.h = false;
-	flags.c = false;
+	set_flags(FlagOp::logic, op1, op2, result, false);
 	return result;
 }
 
 [[nodiscard]] inline u8 CPU::xor8bit(u8 op1, u8 op2)
 {
 	u8 result = op1 ^ op2;
-	flags.z = op1 == 0;
-	flags.n = false;
-	flags.h = false;
-	flags.c = false;
+	set_flags(FlagOp::logic, op1, op2, result, false);
 	return result;
 }
 
 inline void CPU::inc(u8 *addr)
 {
-	flags.n = false;
-	flags.h = 0x0F == (*addr & 0x0F);
-	(*addr)++;
-	flags.z = 0 == *addr;
+	u8 result = *addr + 1;
+	set_flags(FlagOp::inc, *addr, 1, result, flag_c());
+	*addr = result;
 }
 
 inline void CPU::dec(u8 *addr)
 {
-	(*addr)--;
-	flags.z = 0 == *addr;
-	flags.n = true;
-	flags.h = (*addr & 0x0F) == 0x0F;
+	u8 result = *addr - 1;
+	set_flags(FlagOp::dec, *addr, 1, result, flag_c());
+	*addr = result;
 }
 
 /***************************************************
@@ -206,15 +691,11 @@ inline void CPU::dec(u8 *addr)
 
 [[nodiscard]] inline u8 CPU::swap(u8 val)
 {
-	flags.z = val == 0;
-	flags.n = false;
-	flags.h = false;
-	flags.c = false;
-
 	u8 tmp = val & 0x0F;
 	val = val >> 4;
 	val = val | (tmp << 4);
 
+	set_flags(FlagOp::logic, 0, 0, val, false);
 	return val;
 }
 
@@ -224,14 +705,11 @@ inline void CPU::dec(u8 *addr)
 
 [[nodiscard]] inline u8 CPU::rlc(u8 val)
 {
-	flags.c = (val & 0x80);
+	bool carry = (val & 0x80);
 	val <<= 1;
-	val |= flags.c;
-
-	flags.z = val == 0;
-	flags.n = false;
-	flags.h = false;
+	val |= carry;
 
+	set_flags(FlagOp::shift, 0, 0, val, carry);
 	return val;
 }
 
@@ -239,26 +717,19 @@ inline void CPU::dec(u8 *addr)
 {
 	bool carry = (val & 0x80);
 	val <<= 1;
-	val |= flags.c;
-
-	flags.c = carry;
-	flags.z = val == 0;
-	flags.n = false;
-	flags.h = false;
+	val |= flag_c();
 
+	set_flags(FlagOp::shift, 0, 0, val, carry);
 	return val;
 }
 
 [[nodiscard]] inline u8 CPU::rrc(u8 val)
 {
-	flags.c = val & 0x01;
+	bool carry = val & 0x01;
 	val >>= 1;
-	val |= (flags.c << 7);
-
-	flags.z = val == 0;
-	flags.n = false;
-	flags.h = false;
+	val |= (carry << 7);
 
+	set_flags(FlagOp::shift, 0, 0, val, carry);
 	return val;
 }
 
@@ -266,48 +737,38 @@ inline void CPU::dec(u8 *addr)
 {
 	bool carry = (val & 0x01);
 	val >>= 1;
-	val |= (flags.c << 7);
-
-	flags.c = carry;
-	flags.z = val == 0;
-	flags.n = false;
-	flags.h = false;
+	val |= (flag_c() << 7);
 
+	set_flags(FlagOp::shift, 0, 0, val, carry);
 	return val;
 }
 
 [[nodiscard]] inline u8 CPU::sla(u8 val)
 {
-	flags.c = (val & 0x80);
+	bool carry = (val & 0x80);
 	val <<= 1;
-	flags.z = val == 0;
-	flags.n = false;
-	flags.h = false;
 
+	set_flags(FlagOp::shift, 0, 0, val, carry);
 	return val;
 }
 
 [[nodiscard]] inline u8 CPU::sra(u8 val)
 {
 	u8 msb = val & 0x80;
-	flags.c = (val & 0x01);
+	bool carry = (val & 0x01);
 	val >>= 1;
 	val |= msb;
-	flags.z = val == 0;
-	flags.n = false;
-	flags.h = false;
 
+	set_flags(FlagOp::shift, 0, 0, val, carry);
 	return val;
 }
 
 [[nodiscard]] inline u8 CPU::srl(u8 val)
 {
-	flags.c = val & 0x01;
+	bool carry = val & 0x01;
 	val >>= 1;
-	flags.z = val == 0;
-	flags.n = false;
-	flags.h = false;
 
+	set_flags(FlagOp::shift, 0, 0, val, carry);
 	return val;
 }
 
@@ -317,9 +778,7 @@ inline void CPU::dec(u8 *addr)
 
 void inline CPU::bit(u8 bit, u8 reg)
 {
-	flags.z = !(reg & (0x01 << bit));
-	flags.n = false;
-	flags.h = true;
+	set_flags(FlagOp::bit, 0, 0, reg & (0x01 << bit), flag_c());
 }
 
 [[nodiscard]] u8 inline CPU::set(u8 bit, u8 reg)
@@ -332,2504 +791,408 @@ void inline CPU::bit(u8 bit, u8 reg)
 	return reg & ~(0x01 << bit);
 }
 
-/***********************************************
-********** Opcodes of the Gameboy CPU **********
-***********************************************/
-
-/**************************************
- * Section 3.3, p. 65: Commands *
- **************************************/
-
-/**************************************
- * Section 3.3.1, p. 65: 8-Bit Loads *
- **************************************/
+/************************************************
+ * Operand Access for the Instruction Templates *
+ ************************************************/
 
-// LD R,n
-void CPU::ld_b_n()
+template <u8 r> [[nodiscard]] inline u8 CPU::get_r8()
 {
-	B = read_pc();
-} // 0x06
+	if constexpr (r == 0) return B;
+	if constexpr (r == 1) return C;
+	if constexpr (r == 2) return D;
+	if constexpr (r == 3) return E;
+	if constexpr (r == 4) return H;
+	if constexpr (r == 5) return L;
+	if constexpr (r == 6) return read(HL);
+	if constexpr (r == 7) return A;
+}
 
-void CPU::ld_c_n()
+template <u8 r> inline void CPU::set_r8(u8 val)
 {
-	C = read_pc();
-} // 0x0E
+	if constexpr (r == 0) B = val;
+	if constexpr (r == 1) C = val;
+	if constexpr (r == 2) D = val;
+	if constexpr (r == 3) E = val;
+	if constexpr (r == 4) H = val;
+	if constexpr (r == 5) L = val;
+	if constexpr (r == 6) write(HL, val);
+	if constexpr (r == 7) A = val;
+}
 
-void CPU::ld_d_n()
+template <u8 rr> [[nodiscard]] inline u16 &CPU::r16()
 {
-	D = read_pc();
-} // 0x16
+	if constexpr (rr == 0) return BC;
+	if constexpr (rr == 1) return DE;
+	if constexpr (rr == 2) return HL;
+	if constexpr (rr == 3) return SP;
+}
 
-void CPU::ld_e_n()
+template <u8 cc> [[nodiscard]] inline bool CPU::cond()
 {
-	E = read_pc();
-} // 0x1E
+	if constexpr (cc == 0) return !flag_z();
+	if constexpr (cc == 1) return flag_z();
+	if constexpr (cc == 2) return !flag_c();
+	if constexpr (cc == 3) return flag_c();
+}
 
-void CPU::ld_h_n()
+template <u8 op> inline void CPU::alu(u8 val)
 {
-	H = read_pc();
-} // 0x26
+	if constexpr (op == 0) A = add8bit(A, val);
+	if constexpr (op == 1) A = adc8bit(A, val);
+	if constexpr (op == 2) A = sub8bit(A, val);
+	if constexpr (op == 3) A = sbc8bit(A, val);
+	if constexpr (op == 4) A = and8bit(A, val);
+	if constexpr (op == 5) A = xor8bit(A, val);
+	if constexpr (op == 6) A = or8bit(A, val);
+	if constexpr (op == 7) (void)sub8bit(A, val);
+}
 
-void CPU::ld_l_n()
+template <u8 op> [[nodiscard]] inline u8 CPU::shift(u8 val)
 {
-	L = read_pc();
-} // 0x2E
+	if constexpr (op == 0) return rlc(val);
+	if constexpr (op == 1) return rrc(val);
+	if constexpr (op == 2) return rl(val);
+	if constexpr (op == 3) return rr(val);
+	if constexpr (op == 4) return sla(val);
+	if constexpr (op == 5) return sra(val);
+	if constexpr (op == 6) return swap(val);
+	if constexpr (op == 7) return srl(val);
+}
 
-// LD R,R
-void CPU::ld_a_a()
-{
-	A = A;
-} // 0x7F
+/***********************************************
+********** Opcodes of the Gameboy CPU **********
+***********************************************/
 
-void CPU::ld_b_a()
-{
-	B = A;
-} // 0x47
+/**************************************
+ * Section 3.3, p. 65: Commands *
+ **************************************/
 
-void CPU::ld_c_a()
-{
-	C = A;
-} // 0x4F
+/**************************************
+ * Section 3.3.1, p. 65: 8-Bit Loads *
+ **************************************/
 
-void CPU::ld_d_a()
+// LD R,R
+template <u8 dst, u8 src> void CPU::ld_r_r()
 {
-	D = A;
-} // 0x57
+	set_r8<dst>(get_r8<src>());
+} // 0x40 - 0x7F
 
-void CPU::ld_e_a()
+// LD R,n
+template <u8 r> void CPU::ld_r_n()
 {
-	E = A;
-} // 0x5F
+	set_r8<r>(read_pc());
+} // 0x06 | r << 3
 
-void CPU::ld_h_a()
+// LD R,(RR)
+void CPU::ld_a_bc()
 {
-	H = A;
-} // 0x67
+	A = read(BC);
+} // 0x0A
 
-void CPU::ld_l_a()
+void CPU::ld_a_de()
 {
-	L = A;
-} // 0x6F
+	A = read(DE);
+} // 0x1A
 
-void CPU::ld_a_b()
+void CPU::ld_a_nn()
 {
-	A = B;
-} // 0x78
+	A = read(read16_pc());
+} // 0xFA
 
-void CPU::ld_a_c()
+void CPU::ld_bc_a()
 {
-	A = C;
-} // 0x79
+	write(BC, A);
+} // 0x02
 
-void CPU::ld_a_d()
+void CPU::ld_de_a()
 {
-	A = D;
-} // 0x7A
+	write(DE, A);
+} // 0x12
 
-void CPU::ld_a_e()
+void CPU::ld_nn_a()
 {
-	A = E;
-} // 0x7B
+	write(read16_pc(), A);
+} // 0xEA
 
-void CPU::ld_a_h()
+void CPU::ldh_c_a()
 {
-	A = H;
-} // 0x7C
+	write(0xFF00 + C, A);
+} // 0xE2
 
-void CPU::ld_a_l()
+void CPU::ldh_a_c()
 {
-	A = L;
-} // 0x7D
+	A = read(0xFF00 + C);
+} // 0xF2
 
-void CPU::ld_b_b()
+void CPU::ld_a_hld()
 {
-	B = B;
-} // 0x40
+	A = read(HL);
+	HL--;
+} // 0x3A
 
-void CPU::ld_b_c()
+void CPU::ld_hld_a()
 {
-	B = C;
-} // 0x41
+	write(HL, A);
+	HL--;
+} // 0x32
 
-void CPU::ld_b_d()
+void CPU::ld_a_hli()
 {
-	B = D;
-} // 0x42
+	A = read(HL);
+	HL++;
+} // 0x2A
 
-void CPU::ld_b_e()
+void CPU::ld_hli_a()
 {
-	B = E;
-} // 0x43
+	write(HL, A);
+	HL++;
+} // 0x22
 
-void CPU::ld_b_h()
+void CPU::ldh_n_a()
 {
-	B = H;
-} // 0x44
+	write(0xFF00 + read_pc(), A);
+} // 0xE0
 
-void CPU::ld_b_l()
+void CPU::ldh_a_n()
 {
-	B = L;
-} // 0x45
+	A = read(0xFF00 + read_pc());
+} // 0xF0
 
-void CPU::ld_c_b()
-{
-	C = B;
-} // 0x48
+/**************************************
+ * Section 3.3.2, p. 76: 16-Bit Loads *
+ **************************************/
 
-void CPU::ld_c_c()
+// LD RR,nn
+template <u8 rr> void CPU::ld_rr_nn()
 {
-	C = C;
-} // 0x49
+	r16<rr>() = read16_pc();
+} // 0x01 | rr << 4
 
-void CPU::ld_c_d()
+void CPU::ld_sp_hl()
 {
-	C = D;
-} // 0x4A
+	SP = HL;
+} // 0xF9
 
-void CPU::ld_c_e()
+/* Surprisingly, this one Load-Command affects the flag register
+    while all other load-command don't care for the flags */
+void CPU::ldhl_sp_n()
 {
-	C = E;
-} // 0x4B
+	u8 n = read_pc();
+	u32 result = SP + n;
+	sync_flags();
+	flags.z = false;
+	flags.n = false;
+	flags.c = 0x100 == ((SP ^ n ^ result) & 0x100);
+	flags.h = 0x10 == ((SP ^ n ^ result) & 0x10);
+	HL = result;
+} // 0xF8
 
-void CPU::ld_c_h()
+void CPU::ld_nn_sp()
 {
-	C = H;
-} // 0x4C
+	write16(read16_pc(), SP);
+} // 0x08
 
-void CPU::ld_c_l()
+template <u8 rr> void CPU::push_rr()
 {
-	C = L;
-} // 0x4D
+	if constexpr (rr == 3) {
+		sync_flags();
+		push16(AF);
+	} else
+		push16(r16<rr>());
+} // 0xC5 | rr << 4
 
-void CPU::ld_d_b()
+template <u8 rr> void CPU::pop_rr()
 {
-	D = B;
-} // 0x50
+	if constexpr (rr == 3) {
+		AF = pop16();
+		lazy_.op = FlagOp::none;
+	} else
+		r16<rr>() = pop16();
+} // 0xC1 | rr << 4
 
-void CPU::ld_d_c()
-{
-	D = C;
-} // 0x51
+/***********************************
+ * Section 3.3.3, p. 80: 8-Bit ALU *
+ ***********************************/
 
-void CPU::ld_d_d()
+// ADD/ADC/SUB/SBC/AND/XOR/OR/CP A,R
+template <u8 op, u8 r> void CPU::alu_a_r()
 {
-	D = D;
-} // 0x52
+	alu<op>(get_r8<r>());
+} // 0x80 | op << 3 | r
 
-void CPU::ld_d_e()
+// ADD/ADC/SUB/SBC/AND/XOR/OR/CP A,n
+template <u8 op> void CPU::alu_a_n()
 {
-	D = E;
-} // 0x53
+	alu<op>(read_pc());
+} // 0xC6 | op << 3
 
-void CPU::ld_d_h()
+// INC R
+template <u8 r> void CPU::inc_r()
 {
-	D = H;
-} // 0x54
+	u8 val = get_r8<r>();
+	inc(&val);
+	set_r8<r>(val);
+} // 0x04 | r << 3
 
-void CPU::ld_d_l()
+// DEC R
+template <u8 r> void CPU::dec_r()
 {
-	D = L;
-} // 0x55
+	u8 val = get_r8<r>();
+	dec(&val);
+	set_r8<r>(val);
+} // 0x05 | r << 3
 
-void CPU::ld_e_b()
-{
-	E = B;
-} // 0x58
+/************************************
+ * Section 3.3.4, p. 90: 16-Bit ALU *
+ ************************************/
 
-void CPU::ld_e_c()
-{
-	E = C;
-} // 0x59
-
-void CPU::ld_e_d()
-{
-	E = D;
-} // 0x5A
-
-void CPU::ld_e_e()
-{
-	E = E;
-} // 0x5B
-
-void CPU::ld_e_h()
-{
-	E = H;
-} // 0x5C
-
-void CPU::ld_e_l()
-{
-	E = L;
-} // 0x5D
-
-void CPU::ld_h_b()
-{
-	H = B;
-} // 0x60
-
-void CPU::ld_h_c()
-{
-	H = C;
-} // 0x61
-
-void CPU::ld_h_d()
-{
-	H = D;
-} // 0x62
-
-void CPU::ld_h_e()
-{
-	H = E;
-} // 0x63
-
-void CPU::ld_h_h()
-{
-	H = H;
-} // 0x64
-
-void CPU::ld_h_l()
-{
-	H = L;
-} // 0x65
-
-void CPU::ld_l_b()
-{
-	L = B;
-} // 0x68
-
-void CPU::ld_l_c()
-{
-	L = C;
-} // 0x69
-
-void CPU::ld_l_d()
-{
-	L = D;
-} // 0x6A
-
-void CPU::ld_l_e()
-{
-	L = E;
-} // 0x6B
-
-void CPU::ld_l_h()
-{
-	L = H;
-} // 0x6C
-
-void CPU::ld_l_l()
-{
-	L = L;
-} // 0x6D
-
-// LD R,(RR)
-void CPU::ld_a_hl()
-{
-	A = read(HL);
-} // 0x7E
-
-void CPU::ld_b_hl()
-{
-	B = read(HL);
-} // 0x46
-
-void CPU::ld_c_hl()
-{
-	C = read(HL);
-} // 0x4E
-
-void CPU::ld_d_hl()
-{
-	D = read(HL);
-} // 0x56
-
-void CPU::ld_e_hl()
-{
-	E = read(HL);
-} // 0x5E
-
-void CPU::ld_h_hl()
-{
-	H = read(HL);
-} // 0x66
-
-void CPU::ld_l_hl()
-{
-	L = read(HL);
-} // 0x6E
-
-// LD (RR),R
-void CPU::ld_hl_a()
-{
-	write(HL, A);
-} // 0x77
-
-void CPU::ld_hl_b()
-{
-	write(HL, B);
-} // 0x70
-
-void CPU::ld_hl_c()
-{
-	write(HL, C);
-} // 0x71
-
-void CPU::ld_hl_d()
-{
-	write(HL, D);
-} // 0x72
-
-void CPU::ld_hl_e()
-{
-	write(HL, E);
-} // 0x73
-
-void CPU::ld_hl_h()
-{
-	write(HL, H);
-} // 0x74
-
-void CPU::ld_hl_l()
-{
-	write(HL, L);
-} // 0x75
-
-void CPU::ld_hl_n()
-{
-	write(HL, read_pc());
-} // 0x36
-
-// LD R,(RR)
-void CPU::ld_a_bc()
-{
-	A = read(BC);
-} // 0x0A
-
-void CPU::ld_a_de()
-{
-	A = read(DE);
-} // 0x1A
-
-void CPU::ld_a_nn()
-{
-	A = read(read16_pc());
-} // 0xFA
-
-void CPU::ld_a_n()
-{
-	A = read_pc();
-} // 0x3E
-
-void CPU::ld_bc_a()
-{
-	write(BC, A);
-} // 0x02
-
-void CPU::ld_de_a()
-{
-	write(DE, A);
-} // 0x12
-
-void CPU::ld_nn_a()
-{
-	write(read16_pc(), A);
-} // 0xEA
-
-void CPU::ldh_c_a()
-{
-	write(0xFF00 + C, A);
-} // 0xE2
-
-void CPU::ldh_a_c()
-{
-	A = read(0xFF00 + C);
-} // 0xF2
-
-void CPU::ld_a_hld()
-{
-	A = read(HL);
-	HL--;
-} // 0x3A
-
-void CPU::ld_hld_a()
-{
-	write(HL, A);
-	HL--;
-} // 0x32
-
-void CPU::ld_a_hli()
-{
-	A = read(HL);
-	H++;
-} // 0x2A
-
-void CPU::ld_hli_a()
-{
-	write(HL, A);
-	HL++;
-} // 0x22
-
-void CPU::ldh_n_a()
-{
-	write(0xFF00 + read_pc(), A);
-} // 0xE0
-
-void CPU::ldh_a_n()
-{
-	A = read(0xFF00 + read_pc());
-} // 0xF0
-
-/**************************************
- * Section 3.3.2, p. 76: 16-Bit Loads *
- **************************************/
-
-// LD RR,nn
-void CPU::ld_bc_nn()
-{
-	BC = read16_pc();
-} // 0x01
-
-void CPU::ld_de_nn()
-{
-	DE = read16_pc();
-} // 0x11
-
-void CPU::ld_hl_nn()
-{
-	HL = read16_pc();
-} // 0x21
-
-void CPU::ld_sp_nn()
-{
-	SP = read16_pc();
-} // 0x31
-
-void CPU::ld_sp_hl()
-{
-	SP = HL;
-} // 0xF9
-
-/* Surprisingly, this one Load-Command affects the flag register
-    while all other load-command don't care for the flags */
-void CPU::ldhl_sp_n() // 0xF8
-{
-	u8 n = read_pc();
-	u32 result = SP + n;
-	flags.z = false;
-	flags.n = false;
-	flags.c = 0x100 == ((SP ^ n ^ result) & 0x100);
-	flags.h = 0x10 == ((SP ^ n ^ result) & 0x10);
-	HL = result;
-}
-
-void CPU::ld_nn_sp()
-{
-	write16(read16_pc(), SP);
-} // 0x08
-
-void CPU::push_af()
-{
-	push16(AF);
-} // 0xF5
-
-void CPU::push_bc()
-{
-	push16(BC);
-} // 0xC5
-
-void CPU::push_de()
-{
-	push16(DE);
-} // 0xD5
-
-void CPU::push_hl()
-{
-	push16(HL);
-} // 0xE5
-
-void CPU::pop_af()
-{
-	AF = pop16();
-} // 0xF1
-
-void CPU::pop_bc()
-{
-	BC = pop16();
-} // 0xC1
-
-void CPU::pop_de()
-{
-	DE = pop16();
-} // 0xD1
-
-void CPU::pop_hl()
-{
-	HL = pop16();
-} // 0xE1
-
-/***********************************
- * Section 3.3.3, p. 80: 8-Bit ALU *
- ***********************************/
-
-// ADD A,n
-void CPU::add_a_a()
-{
-	A = add8bit(A, A);
-} // 0x87
-
-void CPU::add_a_b()
-{
-	A = add8bit(A, B);
-} // 0x80
-
-void CPU::add_a_c()
-{
-	A = add8bit(A, C);
-} // 0x81
-
-void CPU::add_a_d()
-{
-	A = add8bit(A, D);
-} // 0x82
-
-void CPU::add_a_e()
-{
-	A = add8bit(A, E);
-} // 0x83
-
-void CPU::add_a_h()
-{
-	A = add8bit(A, H);
-} // 0x84
-
-void CPU::add_a_l()
-{
-	A = add8bit(A, L);
-} // 0x85
-
-void CPU::add_a_hl_ref()
-{
-	A = add8bit(A, read(HL));
-} // 0x86
-
-void CPU::add_a_n()
-{
-	A = add8bit(A, read_pc());
-} // 0xC6
-
-// ADC A,n
-void CPU::adc_a_a()
-{
-	A = adc8bit(A, A);
-} // 0x8F
-
-void CPU::adc_a_b()
-{
-	A = adc8bit(A, B);
-} // 0x88
-
-void CPU::adc_a_c()
-{
-	A = adc8bit(A, C);
-} // 0x89
-
-void CPU::adc_a_d()
-{
-	A = adc8bit(A, D);
-} // 0x8A
-
-void CPU::adc_a_e()
-{
-	A = adc8bit(A, E);
-} // 0x8B
-
-void CPU::adc_a_h()
-{
-	A = adc8bit(A, H);
-} // 0x8C
-
-void CPU::adc_a_l()
-{
-	A = add8bit(A, L);
-} // 0x8D
-
-void CPU::adc_a_hl_ref()
-{
-	A = adc8bit(A, read(HL));
-} // 0x8E
-
-void CPU::adc_a_n()
-{
-	A = adc8bit(A, read_pc());
-} // 0xCE
-
-// SUB A, n
-void CPU::sub_a_a()
-{
-	A = sub8bit(A, A);
-} // 0x97
-
-void CPU::sub_a_b()
-{
-	A = sub8bit(A, B);
-} // 0x90
-
-void CPU::sub_a_c()
-{
-	A = sub8bit(A, C);
-} // 0x91
-
-void CPU::sub_a_d()
-{
-	A = sub8bit(A, D);
-} // 0x92
-
-void CPU::sub_a_e()
-{
-	A = sub8bit(A, E);
-} // 0x93
-
-void CPU::sub_a_h()
-{
-	A = sub8bit(A, H);
-} // 0x94
-
-void CPU::sub_a_l()
-{
-	A = sub8bit(A, L);
-} // 0x95
-
-void CPU::sub_a_hl_ref()
-{
-	A = sub8bit(A, read(HL));
-} // 0x96
-
-void CPU::sub_a_n()
-{
-	A = sub8bit(A, read_pc());
-} // 0xD6
-
-// SBC A, n
-void CPU::sbc_a_a()
-{
-	A = sbc8bit(A, A);
-} // 0x9F
-
-void CPU::sbc_a_b()
-{
-	A = sbc8bit(A, B);
-} // 0x98
-
-void CPU::sbc_a_c()
-{
-	A = sbc8bit(A, C);
-} // 0x99
-
-void CPU::sbc_a_d()
-{
-	A = sbc8bit(A, D);
-} // 0x9A
-
-void CPU::sbc_a_e()
-{
-	A = sbc8bit(A, E);
-} // 0x9B
-
-void CPU::sbc_a_h()
-{
-	A = sbc8bit(A, H);
-} // 0x9C
-
-void CPU::sbc_a_l()
-{
-	A = sbc8bit(A, L);
-} // 0x9D
-
-void CPU::sbc_a_hl_ref()
-{
-	A = sbc8bit(A, read(HL));
-} // 0x9E
-
-void CPU::sbc_a_n()
-{
-	A = sbc8bit(A, read_pc());
-} // 0xDE
-
-// AND A, n
-void CPU::and_a_a()
-{
-	A = and8bit(A, A);
-} // 0xA7
-
-void CPU::and_a_b()
-{
-	A = and8bit(A, B);
-} // 0xA0
-
-void CPU::and_a_c()
-{
-	A = and8bit(A, C);
-} // 0xA1
-
-void CPU::and_a_d()
-{
-	A = and8bit(A, D);
-} // 0xA2
-
-void CPU::and_a_e()
-{
-	A = and8bit(A, E);
-} // 0xA3
-
-void CPU::and_a_h()
-{
-	A = and8bit(A, H);
-} // 0xA4
-
-void CPU::and_a_l()
-{
-	A = and8bit(A, L);
-} // 0xA5
-
-void CPU::and_a_hl_ref()
-{
-	A = and8bit(A, read(HL));
-} // 0xA6
-
-void CPU::and_a_n()
-{
-	A = and8bit(A, read_pc());
-} // 0xE6
-
-// OR A, n
-void CPU::or_a_a()
-{
-	A = or8bit(A, A);
-} // 0xB7
-
-void CPU::or_a_b()
-{
-	A = or8bit(A, B);
-} // 0xB0
-
-void CPU::or_a_c()
-{
-	A = or8bit(A, C);
-} // 0xB1
-
-void CPU::or_a_d()
-{
-	A = or8bit(A, D);
-} // 0xB2
-
-void CPU::or_a_e()
-{
-	A = or8bit(A, E);
-} // 0xB3
-
-void CPU::or_a_h()
-{
-	A = or8bit(A, H);
-} // 0xB4
-
-void CPU::or_a_l()
-{
-	A = or8bit(A, L);
-} // 0xB5
-
-void CPU::or_a_hl_ref()
-{
-	A = or8bit(A, read(HL));
-} // 0xB6
-
-void CPU::or_a_n()
-{
-	A = or8bit(A, read_pc());
-} // 0xF6
-
-// XOR A, n
-void CPU::xor_a_a()
-{
-	A = xor8bit(A, A);
-} // 0xAF
-
-void CPU::xor_a_b()
-{
-	A = xor8bit(A, B);
-} // 0xA8
-
-void CPU::xor_a_c()
-{
-	A = xor8bit(A, C);
-} // 0xA9
-
-void CPU::xor_a_d()
-{
-	A = xor8bit(A, D);
-} // 0xAA
-
-void CPU::xor_a_e()
-{
-	A = xor8bit(A, E);
-} // 0xAB
-
-void CPU::xor_a_h()
-{
-	A = xor8bit(A, H);
-} // 0xAC
-
-void CPU::xor_a_l()
-{
-	A = xor8bit(A, L);
-} // 0xAD
-
-void CPU::xor_a_hl_ref()
-{
-	A = xor8bit(A, read(HL));
-} // 0xAE
-
-void CPU::xor_a_n()
-{
-	A = xor8bit(A, read_pc());
-} // 0xEE
-
-// CP A,n
-/* Description of CP command on p. 87:
- * "This is basically an A - n  subtraction instruction but the results are thrown away."
- */
-void CPU::cp_a_a()
-{
-	(void)sub8bit(A, A);
-} // 0xBF
-
-void CPU::cp_a_b()
-{
-	(void)sub8bit(A, B);
-} // 0xB8
-
-void CPU::cp_a_c()
-{
-	(void)sub8bit(A, C);
-} // 0xB9
-
-void CPU::cp_a_d()
-{
-	(void)sub8bit(A, D);
-} // 0xBA
-
-void CPU::cp_a_e()
-{
-	(void)sub8bit(A, E);
-} // 0xBB
-
-void CPU::cp_a_h()
-{
-	(void)sub8bit(A, H);
-} // 0xBC
-
-void CPU::cp_a_l()
-{
-	(void)sub8bit(A, L);
-} // 0xBD
-
-void CPU::cp_a_hl_ref()
-{
-	(void)sub8bit(A, read(HL));
-} // 0xBE
-
-void CPU::cp_a_n()
-{
-	(void)sub8bit(A, read_pc());
-} // 0xFE
-
-// INC R
-void CPU::inc_a()
-{
-	inc(&A);
-} // 0x3C
-
-void CPU::inc_b()
-{
-	inc(&B);
-} // 0x04
-
-void CPU::inc_c()
-{
-	inc(&C);
-} // 0x0C
-
-void CPU::inc_d()
-{
-	inc(&D);
-} // 0x14
-
-void CPU::inc_e()
-{
-	inc(&E);
-} // 0x1C
-void CPU::inc_h()
-{
-	inc(&H);
-} // 0x24
-
-void CPU::inc_l()
-{
-	inc(&L);
-} // 0x2C
-
-void CPU::inc_hl_ref()
-{
-	u8 val = read(HL);
-	inc(&val);
-	write(HL, val);
-} // 0x34
-
-// DEC R
-void CPU::dec_a()
-{
-	dec(&A);
-} // 0x3D
-
-void CPU::dec_b()
-{
-	dec(&B);
-} // 0x05
-
-void CPU::dec_c()
-{
-	dec(&C);
-} // 0x0D
-
-void CPU::dec_d()
-{
-	dec(&D);
-} // 0x15
-
-void CPU::dec_e()
-{
-	dec(&E);
-} // 0x1D
-
-void CPU::dec_h()
-{
-	dec(&H);
-} // 0x25
-
-void CPU::dec_l()
-{
-	dec(&L);
-} // 0x2D
-
-void CPU::dec_hl_ref()
-{
-	u8 val = read(HL);
-	dec(&val);
-	write(HL, val);
-} // 0x35
-
-/************************************
- * Section 3.3.4, p. 90: 16-Bit ALU *
- ************************************/
-
-// ADD HL,RR
-void CPU::add_hl_bc()
-{
-	HL = add16bit(HL, BC);
-} // 0x09
-
-void CPU::add_hl_de()
-{
-	HL = add16bit(HL, DE);
-} // 0x19
-
-void CPU::add_hl_hl()
-{
-	HL = add16bit(HL, HL);
-} // 0x29
-
-void CPU::add_hl_sp()
-{
-	HL = add16bit(HL, SP);
-} // 0x39
-
-// ADD SP,n
-void CPU::add_sp_n()
-{
-	u8 n = read_pc();
-	u32 result = SP + n;
-	flags.z = false;
-	flags.n = false;
-	flags.c = 0x100 == ((SP ^ n ^ result) & 0x100);
-	flags.h = 0x10 == ((SP ^ n ^ result) & 0x10);
-	SP = result;
-} // 0xE8
-
-// INC RR
-void CPU::inc_bc()
-{
-	BC++;
-} // 0x03
-
-void CPU::inc_de()
-{
-	DE++;
-} // 0x13
-
-void CPU::inc_hl()
-{
-	HL++;
-} // 0x23
-
-void CPU::inc_sp()
-{
-	SP++;
-} // 0x33
-
-// DEC RR
-void CPU::dec_bc()
-{
-	BC--;
-} // 0x0B
-
-void CPU::dec_de()
-{
-	DE--;
-} // 0x1B
-
-void CPU::dec_hl()
-{
-	HL--;
-} // 0x2B
-
-void CPU::dec_sp()
-{
-	SP--;
-} // 0x3B
-
-/***************************************
- * Section 3.3.5, p. 94: Miscellaneous *
- ***************************************/
-
-void CPU::swap_a()
-{
-	A = swap(A);
-} // 0xCB 37
-
-void CPU::swap_b()
-{
-	B = swap(B);
-} // 0xCB 30
-
-void CPU::swap_c()
-{
-	C = swap(C);
-} // 0xCB 31
-
-void CPU::swap_d()
-{
-	D = swap(D);
-} // 0xCB 32
-
-void CPU::swap_e()
-{
-	E = swap(E);
-} // 0xCB 33
-
-void CPU::swap_h()
-{
-	H = swap(H);
-} // 0xCB 34
-
-void CPU::swap_l()
-{
-	L = swap(L);
-} // 0xCB 35
-
-void CPU::swap_hl_ref()
-{
-	u8 val = read(HL);
-	A = swap(val);
-	write(HL, val);
-} // 0xCB 36
-
-void CPU::daa()
-{
-	u16 correction = 0;
-	if (flags.h || (!flags.n && ((A & 0x0F) > 0x09)))
-		correction |= 0x06;
-	if (flags.h || (!flags.n && ((A & 0xFF) > 0x99)))
-		correction |= 0x60;
-
-	A += flags.n ? -correction : +correction;
-
-	flags.c = A > 0x99;
-	flags.z = A == 0;
-	flags.h = false;
-} // 0x27
-
-void CPU::cpl()
-{
-	A = ~A;
-} // 0x2F
-
-void CPU::ccf()
-{
-	flags.c = !flags.c;
-} // 0x3F
-
-void CPU::scf()
-{
-	F |= 0b001'0000;
-} // 0x37
-void CPU::nop()
-{
-} // 0x00
-
-void CPU::halt()
-{
-	halt_ = true;
-} // 0x76
-
-void CPU::stop()
-{
-	stop_ = true;
-} // 0x10
-
-void CPU::di()
-{
-	interruptable_ = false;
-} // 0xF3
-
-void CPU::ei()
-{
-	interruptable_ = true;
-} // 0xFB
-
-/******************************************
- * Section 3.3.6, p. 99: Rotates & Shifts *
- ******************************************/
-
-void CPU::rlca()
-{
-	flags.c = (A & 0x80);
-	A <<= 1;
-	A |= flags.c;
-
-	flags.z = A == 0;
-	flags.n = false;
-	flags.h = false;
-} // 0x07
-
-void CPU::rla()
-{
-	bool carry = (A & 0x80);
-	A <<= 1;
-	A |= flags.c;
-
-	flags.c = carry;
-	flags.z = A == 0;
-	flags.n = false;
-	flags.h = false;
-} // 0x17
-
-void CPU::rrca()
-{
-	flags.c = A & 0x01;
-	A >>= 1;
-	A |= (flags.c << 7);
-
-	flags.z = A == 0;
-	flags.n = false;
-	flags.h = false;
-}
-
-void CPU::rra() // 0x1F
-{
-	bool carry = (A & 0x01);
-	A >>= 1;
-	A |= (flags.c << 7);
-
-	flags.c = carry;
-	flags.z = A == 0;
-	flags.n = false;
-	flags.h = false;
-} // 0x0F
-
-// RLC n
-void CPU::rlc_a()
-{
-	A = rlc(A);
-} // 0xCB 07
-
-void CPU::rlc_b()
-{
-	B = rlc(B);
-} // 0xCB 00
-
-void CPU::rlc_c()
-{
-	C = rlc(C);
-} // 0xCB 01
-
-void CPU::rlc_d()
-{
-	D = rlc(D);
-} // 0xCB 02
-
-void CPU::rlc_e()
-{
-	E = rlc(E);
-} // 0xCB 03
-
-void CPU::rlc_h()
-{
-	H = rlc(H);
-} // 0xCB 04
-
-void CPU::rlc_l()
-{
-	L = rlc(L);
-} // 0xCB 05
-
-void CPU::rlc_hl_ref()
-{
-	u16 val = rlc(read(HL));
-	write(HL, val);
-} // 0xCB 06
-
-// RL n
-void CPU::rl_a()
-{
-	A = rl(A);
-} // 0xCB 17
-
-void CPU::rl_b()
-{
-	B = rl(B);
-} // 0xCB 10
-
-void CPU::rl_c()
-{
-	C = rl(C);
-} // 0xCB 11
-
-void CPU::rl_d()
-{
-	D = rl(D);
-} // 0xCB 12
-
-void CPU::rl_e()
-{
-	E = rl(E);
-} // 0xCB 13
-
-void CPU::rl_h()
-{
-	H = rl(H);
-} // 0xCB 14
-
-void CPU::rl_l()
-{
-	L = rl(L);
-} // 0xCB 15
-
-void CPU::rl_hl_ref()
-{
-	u16 val = rl(read(HL));
-	write(HL, val);
-} // 0xCB 16
-
-// RRC n
-void CPU::rrc_a()
-{
-	A = rrc(A);
-} // 0xCB 0F
-
-void CPU::rrc_b()
-{
-	B = rrc(B);
-} // 0xCB 08
-
-void CPU::rrc_c()
-{
-	C = rrc(C);
-} // 0xCB 09
-
-void CPU::rrc_d()
-{
-	D = rrc(D);
-} // 0xCB 0A
-
-void CPU::rrc_e()
-{
-	E = rrc(E);
-} // 0xCB 0B
-
-void CPU::rrc_h()
-{
-	H = rrc(H);
-} // 0xCB 0C
-
-void CPU::rrc_l()
-{
-	L = rrc(L);
-} // 0xCB 0D
-
-void CPU::rrc_hl_ref()
-{
-	u16 val = rrc(read(HL));
-	write(HL, val);
-} // 0xCB 0E
-
-// RR n
-void CPU::rr_a()
-{
-	A = rr(A);
-} // 0xCB 1F
-
-void CPU::rr_b()
-{
-	B = rr(B);
-} // 0xCB 18
-
-void CPU::rr_c()
-{
-	C = rr(C);
-} // 0xCB 19
-
-void CPU::rr_d()
-{
-	D = rr(D);
-} // 0xCB 1A
-
-void CPU::rr_e()
-{
-	E = rr(E);
-} // 0xCB 1B
-
-void CPU::rr_h()
-{
-	H = rr(H);
-} // 0xCB 1C
-
-void CPU::rr_l()
-{
-	L = rr(L);
-} // 0xCB 1D
-
-void CPU::rr_hl_ref()
-{
-	u16 val = rr(read(HL));
-	write(HL, val);
-} // 0xCB 1E
-
-// SLA n
-void CPU::sla_a()
-{
-	A = sla(A);
-} // 0xCB 27
-
-void CPU::sla_b()
-{
-	B = sla(B);
-} // 0xCB 20
-
-void CPU::sla_c()
-{
-	C = sla(C);
-} // 0xCB 21
-
-void CPU::sla_d()
-{
-	D = sla(D);
-} // 0xCB 22
-
-void CPU::sla_e()
-{
-	E = sla(E);
-} // 0xCB 23
-
-void CPU::sla_h()
-{
-	H = sla(H);
-} // 0xCB 24
-
-void CPU::sla_l()
-{
-	L = sla(L);
-} // 0xCB 25
-
-void CPU::sla_hl_ref()
-{
-	u8 val = sla(read(HL));
-	write(HL, val);
-} // 0xCB 26
-
-// SRA n
-void CPU::sra_a()
-{
-	A = sra(A);
-} // 0xCB 2F
-
-void CPU::sra_b()
-{
-	B = sra(B);
-} // 0xCB 28
-
-void CPU::sra_c()
-{
-	C = sra(C);
-} // 0xCB 29
-
-void CPU::sra_d()
-{
-	D = sra(D);
-} // 0xCB 2A
-
-void CPU::sra_e()
-{
-	E = sra(E);
-} // 0xCB 2B
-
-void CPU::sra_h()
-{
-	H = sra(H);
-} // 0xCB 2C
-
-void CPU::sra_l()
-{
-	L = sra(L);
-} // 0xCB 2D
-
-void CPU::sra_hl_ref()
-{
-	u8 val = sra(read(HL));
-	write(HL, val);
-} // 0xCB 2E
-
-// SRL n
-void CPU::srl_a()
-{
-	A = srl(A);
-} // 0xCB 3F
-
-void CPU::srl_b()
-{
-	B = srl(B);
-} // 0xCB 38
-
-void CPU::srl_c()
-{
-	C = srl(C);
-} // 0xCB 39
-
-void CPU::srl_d()
-{
-	D = srl(D);
-} // 0xCB 3A
-
-void CPU::srl_e()
-{
-	E = srl(E);
-} // 0xCB 3B
-
-void CPU::srl_h()
-{
-	H = srl(H);
-} // 0xCB 3C
-
-void CPU::srl_l()
-{
-	L = srl(L);
-} // 0xCB 3D
-
-void CPU::srl_hl_ref()
-{
-	u8 val = srl(read(HL));
-	write(HL, val);
-} // 0xCB 3E
-
-/**************************************
- * Section 3.3.7, p. 108: Bit Opcodes *
- **************************************/
-
-// BIT (test bit)
-void CPU::bit_a_0()
-{
-	bit(0, A);
-} // 0xCB 47
-
-void CPU::bit_b_0()
-{
-	bit(0, B);
-} // 0xCB 40
-
-void CPU::bit_c_0()
-{
-	bit(0, C);
-} // 0xCB 41
-
-void CPU::bit_d_0()
-{
-	bit(0, D);
-} // 0xCB 42
-
-void CPU::bit_e_0()
-{
-	bit(0, E);
-} // 0xCB 43
-
-void CPU::bit_h_0()
-{
-	bit(0, H);
-} // 0xCB 44
-
-void CPU::bit_l_0()
-{
-	bit(0, L);
-} // 0xCB 45
-
-void CPU::bit_hl_ref_0()
-{
-	bit(0, read(HL));
-} // 0xCB 46
-
-void CPU::bit_a_1()
-{
-	bit(1, A);
-} // 0xCB 4F
-
-void CPU::bit_b_1()
-{
-	bit(1, B);
-} // 0xCB 48
-
-void CPU::bit_c_1()
-{
-	bit(1, C);
-} // 0xCB 49
-
-void CPU::bit_d_1()
-{
-	bit(1, D);
-} // 0xCB 4A
-
-void CPU::bit_e_1()
-{
-	bit(1, E);
-} // 0xCB 4B
-
-void CPU::bit_h_1()
-{
-	bit(1, H);
-} // 0xCB 4C
-
-void CPU::bit_l_1()
-{
-	bit(1, L);
-} // 0xCB 4D
-
-void CPU::bit_hl_ref_1()
-{
-	bit(1, read(HL));
-} // 0xCB 4E
-
-void CPU::bit_a_2()
-{
-	bit(2, A);
-} // 0xCB 57
-
-void CPU::bit_b_2()
-{
-	bit(2, B);
-} // 0xCB 50
-
-void CPU::bit_c_2()
-{
-	bit(2, C);
-} // 0xCB 51
-
-void CPU::bit_d_2()
-{
-	bit(2, D);
-} // 0xCB 52
-
-void CPU::bit_e_2()
-{
-	bit(2, E);
-} // 0xCB 53
-
-void CPU::bit_h_2()
-{
-	bit(2, H);
-} // 0xCB 54
-
-void CPU::bit_l_2()
-{
-	bit(2, L);
-} // 0xCB 55
-
-void CPU::bit_hl_ref_2()
-{
-	bit(2, read(HL));
-} // 0xCB 56
-
-void CPU::bit_a_3()
-{
-	bit(3, A);
-} // 0xCB 5F
-
-void CPU::bit_b_3()
-{
-	bit(3, B);
-} // 0xCB 58
-
-void CPU::bit_c_3()
-{
-	bit(3, C);
-} // 0xCB 59
-
-void CPU::bit_d_3()
-{
-	bit(3, D);
-} // 0xCB 5A
-
-void CPU::bit_e_3()
-{
-	bit(3, E);
-} // 0xCB 5B
-
-void CPU::bit_h_3()
-{
-	bit(3, H);
-} // 0xCB 5C
-
-void CPU::bit_l_3()
-{
-	bit(3, L);
-} // 0xCB 5D
-
-void CPU::bit_hl_ref_3()
-{
-	bit(3, read(HL));
-} // 0xCB 5E
-
-void CPU::bit_a_4()
-{
-	bit(4, A);
-} // 0xCB 67
-
-void CPU::bit_b_4()
-{
-	bit(4, B);
-} // 0xCB 60
-
-void CPU::bit_c_4()
-{
-	bit(4, C);
-} // 0xCB 61
-
-void CPU::bit_d_4()
-{
-	bit(4, D);
-} // 0xCB 62
-
-void CPU::bit_e_4()
-{
-	bit(4, E);
-} // 0xCB 63
-
-void CPU::bit_h_4()
-{
-	bit(4, H);
-} // 0xCB 64
-
-void CPU::bit_l_4()
-{
-	bit(4, L);
-} // 0xCB 65
-
-void CPU::bit_hl_ref_4()
-{
-	bit(4, read(HL));
-} // 0xCB 66
-
-void CPU::bit_a_5()
-{
-	bit(5, A);
-} // 0xCB 6F
-
-void CPU::bit_b_5()
-{
-	bit(5, B);
-} // 0xCB 68
-
-void CPU::bit_c_5()
-{
-	bit(5, C);
-} // 0xCB 69
-
-void CPU::bit_d_5()
-{
-	bit(5, D);
-} // 0xCB 6A
-
-void CPU::bit_e_5()
-{
-	bit(5, E);
-} // 0xCB 6B
-
-void CPU::bit_h_5()
-{
-	bit(5, H);
-} // 0xCB 6C
-
-void CPU::bit_l_5()
-{
-	bit(5, L);
-} // 0xCB 6D
-
-void CPU::bit_hl_ref_5()
-{
-	bit(5, read(HL));
-} // 0xCB 6E
-
-void CPU::bit_a_6()
-{
-	bit(6, A);
-} // 0xCB 77
-
-void CPU::bit_b_6()
-{
-	bit(6, B);
-} // 0xCB 70
-
-void CPU::bit_c_6()
-{
-	bit(6, C);
-} // 0xCB 71
-
-void CPU::bit_d_6()
-{
-	bit(6, D);
-} // 0xCB 72
-
-void CPU::bit_e_6()
-{
-	bit(6, E);
-} // 0xCB 73
-
-void CPU::bit_h_6()
-{
-	bit(6, H);
-} // 0xCB 74
-
-void CPU::bit_l_6()
-{
-	bit(6, L);
-} // 0xCB 75
-
-void CPU::bit_hl_ref_6()
-{
-	bit(6, read(HL));
-} // 0xCB 76
-
-void CPU::bit_a_7()
-{
-	bit(7, A);
-} // 0xCB 7F
-
-void CPU::bit_b_7()
-{
-	bit(7, B);
-} // 0xCB 78
-
-void CPU::bit_c_7()
-{
-	bit(7, C);
-} // 0xCB 79
-
-void CPU::bit_d_7()
-{
-	bit(7, D);
-} // 0xCB 7A
-
-void CPU::bit_e_7()
-{
-	bit(7, E);
-} // 0xCB 7B
-
-void CPU::bit_h_7()
-{
-	bit(7, H);
-} // 0xCB 7C
-
-void CPU::bit_l_7()
-{
-	bit(7, L);
-} // 0xCB 7D
-
-void CPU::bit_hl_ref_7()
-{
-	bit(7, read(HL));
-} // 0xCB 7E
-
-// RES (reset bit)
-void CPU::res_a_0()
-{
-	A = res(0, A);
-} // 0xCB 87
-
-void CPU::res_b_0()
-{
-	B = res(0, B);
-} // 0xCB 80
-
-void CPU::res_c_0()
-{
-	C = res(0, C);
-} // 0xCB 81
-
-void CPU::res_d_0()
-{
-	D = res(0, D);
-} // 0xCB 82
-
-void CPU::res_e_0()
-{
-	E = res(0, E);
-} // 0xCB 83
-
-void CPU::res_h_0()
-{
-	H = res(0, H);
-} // 0xCB 84
-
-void CPU::res_l_0()
-{
-	L = res(0, L);
-} // 0xCB 85
-
-void CPU::res_hl_ref_0()
-{
-	u8 val = res(0, read(HL));
-	write(HL, val);
-} // 0xCB 86
-
-void CPU::res_a_1()
-{
-	A = res(1, A);
-} // 0xCB 8F
-
-void CPU::res_b_1()
-{
-	B = res(1, B);
-} // 0xCB 88
-
-void CPU::res_c_1()
-{
-	C = res(1, C);
-} // 0xCB 89
-
-void CPU::res_d_1()
-{
-	D = res(1, D);
-} // 0xCB 8A
-
-void CPU::res_e_1()
-{
-	E = res(1, E);
-} // 0xCB 8B
-
-void CPU::res_h_1()
-{
-	H = res(1, H);
-} // 0xCB 8C
-
-void CPU::res_l_1()
-{
-	L = res(1, L);
-} // 0xCB 8D
-
-void CPU::res_hl_ref_1()
-{
-	u8 val = res(1, read(HL));
-	write(HL, val);
-} // 0xCB 8E
-
-void CPU::res_a_2()
-{
-	A = res(2, A);
-} // 0xCB 97
-
-void CPU::res_b_2()
-{
-	B = res(2, B);
-} // 0xCB 90
-
-void CPU::res_c_2()
-{
-	C = res(2, C);
-} // 0xCB 91
-
-void CPU::res_d_2()
-{
-	D = res(2, D);
-} // 0xCB 92
-
-void CPU::res_e_2()
-{
-	E = res(2, E);
-} // 0xCB 93
-
-void CPU::res_h_2()
-{
-	H = res(2, H);
-} // 0xCB 94
-
-void CPU::res_l_2()
-{
-	L = res(3, L);
-} // 0xCB 95
-
-void CPU::res_hl_ref_2()
-{
-	u8 val = res(2, read(HL));
-	write(HL, val);
-} // 0xCB 96
-
-void CPU::res_a_3()
-{
-	A = res(3, A);
-} // 0xCB 9F
-
-void CPU::res_b_3()
-{
-	B = res(3, B);
-} // 0xCB 98
-
-void CPU::res_c_3()
-{
-	C = res(3, C);
-} // 0xCB 99
-
-void CPU::res_d_3()
-{
-	D = res(3, D);
-} // 0xCB 9A
-
-void CPU::res_e_3()
-{
-	E = res(3, E);
-} // 0xCB 9B
-
-void CPU::res_h_3()
-{
-	H = res(3, H);
-} // 0xCB 9C
-
-void CPU::res_l_3()
-{
-	L = res(3, L);
-} // 0xCB 9D
-
-void CPU::res_hl_ref_3()
-{
-	u8 val = res(3, read(HL));
-	write(HL, val);
-} // 0xCB 9E
-
-void CPU::res_a_4()
-{
-	A = res(4, A);
-} // 0xCB A7
-
-void CPU::res_b_4()
-{
-	B = res(4, B);
-} // 0xCB A0
-
-void CPU::res_c_4()
-{
-	C = res(4, C);
-} // 0xCB A1
-
-void CPU::res_d_4()
-{
-	D = res(4, D);
-} // 0xCB A2
-
-void CPU::res_e_4()
-{
-	E = res(4, E);
-} // 0xCB A3
-
-void CPU::res_h_4()
-{
-	H = res(4, H);
-} // 0xCB A4
-
-void CPU::res_l_4()
-{
-	L = res(4, L);
-} // 0xCB A5
-
-void CPU::res_hl_ref_4()
-{
-	u8 val = res(4, read(HL));
-	write(HL, val);
-} // 0xCB A6
-
-void CPU::res_a_5()
-{
-	A = res(5, A);
-} // 0xCB AF
-
-void CPU::res_b_5()
-{
-	B = res(5, B);
-} // 0xCB A8
-
-void CPU::res_c_5()
-{
-	C = res(5, C);
-} // 0xCB A9
-
-void CPU::res_d_5()
-{
-	D = res(5, D);
-} // 0xCB AA
-
-void CPU::res_e_5()
-{
-	E = res(5, E);
-} // 0xCB AB
-
-void CPU::res_h_5()
-{
-	H = res(5, H);
-} // 0xCB AC
-
-void CPU::res_l_5()
-{
-	L = res(5, L);
-} // 0xCB AD
-
-void CPU::res_hl_ref_5()
-{
-	u8 val = res(5, read(HL));
-	write(HL, val);
-} // 0xCB AE
-
-void CPU::res_a_6()
-{
-	A = res(6, A);
-} // 0xCB B7
-
-void CPU::res_b_6()
-{
-	B = res(6, B);
-} // 0xCB B0
-
-void CPU::res_c_6()
-{
-	C = res(6, C);
-} // 0xCB B1
-
-void CPU::res_d_6()
-{
-	D = res(6, D);
-} // 0xCB B2
-
-void CPU::res_e_6()
-{
-	E = res(6, E);
-} // 0xCB B3
-
-void CPU::res_h_6()
-{
-	H = res(6, H);
-} // 0xCB B4
-
-void CPU::res_l_6()
-{
-	L = res(6, L);
-} // 0xCB B5
-
-void CPU::res_hl_ref_6()
-{
-	u8 val = res(6, read(HL));
-	write(HL, val);
-} // 0xCB B6
-
-void CPU::res_a_7()
-{
-	A = res(7, A);
-} // 0xCB BF
-
-void CPU::res_b_7()
-{
-	B = res(7, B);
-} // 0xCB B8
-
-void CPU::res_c_7()
-{
-	C = res(7, C);
-} // 0xCB B9
-
-void CPU::res_d_7()
-{
-	D = res(7, D);
-} // 0xCB BA
-
-void CPU::res_e_7()
-{
-	E = res(7, E);
-} // 0xCB BB
-
-void CPU::res_h_7()
-{
-	H = res(7, H);
-} // 0xCB BC
-
-void CPU::res_l_7()
-{
-	L = res(8, L);
-} // 0xCB BD
-
-void CPU::res_hl_ref_7()
-{
-	u8 val = res(7, read(HL));
-	write(HL, val);
-} // 0xCB BE
-
-// SET (set bit)
-void CPU::set_a_0()
-{
-	A = set(0, A);
-} // 0xCB C7
-
-void CPU::set_b_0()
-{
-	B = set(0, B);
-} // 0xCB C0
-
-void CPU::set_c_0()
-{
-	C = set(0, C);
-} // 0xCB C1
-
-void CPU::set_d_0()
-{
-	D = set(0, D);
-} // 0xCB C2
-
-void CPU::set_e_0()
-{
-	E = set(0, E);
-} // 0xCB C3
-
-void CPU::set_h_0()
-{
-	H = set(0, H);
-} // 0xCB C4
-
-void CPU::set_l_0()
-{
-	L = set(0, L);
-} // 0xCB C5
-
-void CPU::set_hl_ref_0()
-{
-	u8 val = set(0, read(HL));
-	write(HL, val);
-} // 0xCB C6
-
-void CPU::set_a_1()
-{
-	A = set(1, A);
-} // 0xCB CF
-
-void CPU::set_b_1()
-{
-	B = set(1, B);
-} // 0xCB C8
-
-void CPU::set_c_1()
-{
-	C = set(1, C);
-} // 0xCB C9
-
-void CPU::set_d_1()
-{
-	D = set(1, D);
-} // 0xCB CA
-
-void CPU::set_e_1()
-{
-	E = set(1, E);
-} // 0xCB CB
-
-void CPU::set_h_1()
-{
-	H = set(1, H);
-} // 0xCB CC
-
-void CPU::set_l_1()
-{
-	L = set(1, L);
-} // 0xCB CD
-
-void CPU::set_hl_ref_1()
-{
-	u8 val = set(1, read(HL));
-	write(HL, val);
-} // 0xCB CE
-
-void CPU::set_a_2()
-{
-	A = set(2, A);
-} // 0xCB D7
-
-void CPU::set_b_2()
-{
-	B = set(2, B);
-} // 0xCB D0
-
-void CPU::set_c_2()
-{
-	C = set(2, C);
-} // 0xCB D1
-
-void CPU::set_d_2()
-{
-	D = set(2, D);
-} // 0xCB D2
-
-void CPU::set_e_2()
-{
-	E = set(2, E);
-} // 0xCB D3
-
-void CPU::set_h_2()
-{
-	H = set(2, H);
-} // 0xCB D4
-
-void CPU::set_l_2()
-{
-	L = set(2, L);
-} // 0xCB D5
-
-void CPU::set_hl_ref_2()
-{
-	u8 val = set(2, read(HL));
-	write(HL, val);
-} // 0xCB D6
-
-void CPU::set_a_3()
-{
-	A = set(3, A);
-} // 0xCB DF
-
-void CPU::set_b_3()
-{
-	B = set(3, B);
-} // 0xCB D8
-
-void CPU::set_c_3()
-{
-	C = set(3, C);
-} // 0xCB D9
-
-void CPU::set_d_3()
-{
-	D = set(3, D);
-} // 0xCB DA
-
-void CPU::set_e_3()
-{
-	E = set(3, E);
-} // 0xCB DB
-
-void CPU::set_h_3()
-{
-	H = set(3, H);
-} // 0xCB DC
-
-void CPU::set_l_3()
-{
-	L = set(4, L);
-} // 0xCB DD
-
-void CPU::set_hl_ref_3()
-{
-	u8 val = set(3, read(HL));
-	write(HL, val);
-} // 0xCB DE
-
-void CPU::set_a_4()
-{
-	A = set(4, A);
-} // 0xCB E7
-
-void CPU::set_b_4()
-{
-	B = set(4, B);
-} // 0xCB E0
-
-void CPU::set_c_4()
-{
-	C = set(4, C);
-} // 0xCB E1
-
-void CPU::set_d_4()
-{
-	D = set(4, D);
-} // 0xCB E2
-
-void CPU::set_e_4()
-{
-	E = set(4, E);
-} // 0xCB E3
-
-void CPU::set_h_4()
-{
-	H = set(4, H);
-} // 0xCB E4
-
-void CPU::set_l_4()
+// ADD HL,RR
+template <u8 rr> void CPU::add_hl_rr()
 {
-	L = set(4, L);
-} // 0xCB E5
+	HL = add16bit(HL, r16<rr>());
+} // 0x09 | rr << 4
 
-void CPU::set_hl_ref_4()
+// ADD SP,n
+void CPU::add_sp_n()
 {
-	u8 val = set(4, read(HL));
-	write(HL, val);
-} // 0xCB E6
+	u8 n = read_pc();
+	u32 result = SP + n;
+	sync_flags();
+	flags.z = false;
+	flags.n = false;
+	flags.c = 0x100 == ((SP ^ n ^ result) & 0x100);
+	flags.h = 0x10 == ((SP ^ n ^ result) & 0x10);
+	SP = result;
+} // 0xE8
 
-void CPU::set_a_5()
+// INC RR
+template <u8 rr> void CPU::inc_rr()
 {
-	A = set(5, A);
-} // 0xCB EF
+	r16<rr>()++;
+} // 0x03 | rr << 4
 
-void CPU::set_b_5()
+// DEC RR
+template <u8 rr> void CPU::dec_rr()
 {
-	B = set(5, B);
-} // 0xCB E8
+	r16<rr>()--;
+} // 0x0B | rr << 4
 
-void CPU::set_c_5()
-{
-	C = set(5, C);
-} // 0xCB E9
+/***************************************
+ * Section 3.3.5, p. 94: Miscellaneous *
+ ***************************************/
 
-void CPU::set_d_5()
+void CPU::daa()
 {
-	D = set(5, D);
-} // 0xCB EA
+	sync_flags();
+	u16 correction = 0;
+	if (flags.h || (!flags.n && ((A & 0x0F) > 0x09)))
+		correction |= 0x06;
+	if (flags.h || (!flags.n && ((A & 0xFF) > 0x99)))
+		correction |= 0x60;
 
-void CPU::set_e_5()
-{
-	E = set(5, E);
-} // 0xCB EB
+	A += flags.n ? -correction : +correction;
 
-void CPU::set_h_5()
-{
-	H = set(5, H);
-} // 0xCB EC
+	flags.c = A > 0x99;
+	flags.z = A == 0;
+	flags.h = false;
+} // 0x27
 
-void CPU::set_l_5()
+void CPU::cpl()
 {
-	L = set(5, L);
-} // 0xCB ED
+	A = ~A;
+} // 0x2F
 
-void CPU::set_hl_ref_5()
+void CPU::ccf()
 {
-	u8 val = set(5, read(HL));
-	write(HL, val);
-} // 0xCB EE
+	sync_flags();
+	flags.c = !flags.c;
+} // 0x3F
 
-void CPU::set_a_6()
+void CPU::scf()
 {
-	A = set(6, A);
-} // 0xCB F7
-
-void CPU::set_b_6()
+	sync_flags();
+	F |= 0b001'0000;
+} // 0x37
+void CPU::nop()
 {
-	B = set(6, B);
-} // 0xCB F0
+} // 0x00
 
-void CPU::set_c_6()
+void CPU::halt()
 {
-	C = set(6, C);
-} // 0xCB F1
+	// an interrupt which is already pending ends HALT right away
+	if (!(read(IF) & read(IE) & 0x1F))
+		halt_ = true;
+} // 0x76
 
-void CPU::set_d_6()
+void CPU::stop()
 {
-	D = set(6, D);
-} // 0xCB F2
+	stop_ = true;
+	write(0xFF04, 0); // resets DIV
+} // 0x10
 
-void CPU::set_e_6()
+void CPU::di()
 {
-	E = set(6, E);
-} // 0xCB F3
+	interruptable_ = false;
+} // 0xF3
 
-void CPU::set_h_6()
+// Takes effect after the next instruction
+void CPU::ei()
 {
-	H = set(6, H);
-} // 0xCB F4
+	interruptable_ = true;
+	sched.schedule(Scheduler::irq, cycles + 1);
+} // 0xFB
 
-void CPU::set_l_6()
-{
-	L = set(6, L);
-} // 0xCB F5
+/******************************************
+ * Section 3.3.6, p. 99: Rotates & Shifts *
+ ******************************************/
 
-void CPU::set_hl_ref_6()
+void CPU::rlca()
 {
-	u8 val = set(6, read(HL));
-	write(HL, val);
-} // 0xCB F6
+	A = rlc(A);
+} // 0x07
 
-void CPU::set_a_7()
+void CPU::rla()
 {
-	A = set(7, A);
-} // 0xCB FF
+	A = rl(A);
+} // 0x17
 
-void CPU::set_b_7()
+void CPU::rrca()
 {
-	B = set(7, B);
-} // 0xCB F8
+	A = rrc(A);
+} // 0x0F
 
-void CPU::set_c_7()
+void CPU::rra()
 {
-	C = set(7, C);
-} // 0xCB F9
+	A = rr(A);
+} // 0x1F
 
-void CPU::set_d_7()
+// RLC/RRC/RL/RR/SLA/SRA/SWAP/SRL R
+template <u8 op, u8 r> void CPU::shift_r()
 {
-	D = set(7, D);
-} // 0xCB FA
+	set_r8<r>(shift<op>(get_r8<r>()));
+} // 0xCB 00 | op << 3 | r
 
-void CPU::set_e_7()
-{
-	E = set(7, E);
-} // 0xCB FB
+/**************************************
+ * Section 3.3.7, p. 108: Bit Opcodes *
+ **************************************/
 
-void CPU::set_h_7()
+// BIT (test bit)
+template <u8 b, u8 r> void CPU::bit_r()
 {
-	H = set(7, H);
-} // 0xCB FC
+	bit(b, get_r8<r>());
+} // 0xCB 40 | b << 3 | r
 
-void CPU::set_l_7()
+// RES (reset bit)
+template <u8 b, u8 r> void CPU::res_r()
 {
-	L = set(7, L);
-} // 0xCB FD
+	set_r8<r>(res(b, get_r8<r>()));
+} // 0xCB 80 | b << 3 | r
 
-void CPU::set_hl_ref_7()
+// SET (set bit)
+template <u8 b, u8 r> void CPU::set_r()
 {
-	u8 val = set(7, read(HL));
-	write(HL, val);
-} // 0xCB FE
+	set_r8<r>(set(b, get_r8<r>()));
+} // 0xCB C0 | b << 3 | r
 
 /********************************
  * Section 3.3.8, p. 108: Jumps *
@@ -2841,38 +1204,14 @@ void CPU::jp_nn()
 } // 0xC3
 
 // JP cc,nn
-void CPU::jp_nz_nn()
-{
-	if (!flags.z)
-		jp_nn();
-	else {
-		PC += 2;
-	}
-} // 0xC2
-
-void CPU::jp_z_nn()
-{
-	if (flags.z)
-		jp_nn();
-	else
-		PC += 2;
-} // 0xCA
-
-void CPU::jp_nc_nn()
-{
-	if (!flags.c)
-		jp_nn();
-	else
-		PC += 2;
-} // 0xD2
-
-void CPU::jp_c_nn()
+template <u8 cc> void CPU::jp_cc_nn()
 {
-	if (flags.c)
+	if (cond<cc>()) {
 		jp_nn();
-	else
+		cycles += 1;
+	} else
 		PC += 2;
-} // 0xDA
+} // 0xC2 | cc << 3
 
 void CPU::jp_hl()
 {
@@ -2881,41 +1220,19 @@ void CPU::jp_hl()
 
 void CPU::jr_n()
 {
-	PC += (i8)read_pc() - 1;
+	i8 offset = read_pc();
+	PC += offset;
 } // 0x18
 
 // JR CC,n
-void CPU::jr_nz_n()
-{
-	if (!flags.z)
-		jr_n();
-	else
-		PC += 1;
-} // 0x20
-
-void CPU::jr_z_n()
-{
-	if (flags.z)
-		jr_n();
-	else
-		PC += 1;
-} // 0x28
-
-void CPU::jr_nc_n()
-{
-	if (!flags.c)
-		jr_n();
-	else
-		PC += 1;
-} // 0x30
-
-void CPU::jr_c_n()
+template <u8 cc> void CPU::jr_cc_n()
 {
-	if (flags.c)
+	if (cond<cc>()) {
 		jr_n();
-	else
+		cycles += 1;
+	} else
 		PC += 1;
-} // 0x38
+} // 0x20 | cc << 3
 
 /********************************
  * Section 3.3.9, p. 108: Calls *
@@ -2928,82 +1245,25 @@ void CPU::call_nn()
 } // 0xCD
 
 // CALL cc,nn
-void CPU::call_nz_nn()
-{
-	if (!flags.z)
-		call_nn();
-} // 0xC4
-
-void CPU::call_z_nn()
-{
-	if (flags.z)
-		call_nn();
-} // 0xCC
-
-void CPU::call_nc_nn()
-{
-	if (!flags.c)
-		call_nn();
-} // 0xD4
-
-void CPU::call_c_nn()
+template <u8 cc> void CPU::call_cc_nn()
 {
-	if (flags.c)
+	if (cond<cc>()) {
 		call_nn();
-} // 0xDC
+		cycles += 3;
+	} else
+		PC += 2;
+} // 0xC4 | cc << 3
 
 /************************************
  * Section 3.3.10, p. 108: Restarts *
  ************************************/
 
 // RST, n
-void CPU::rst_00()
-{
-	push(PC);
-	PC = 0x00;
-} // 0xC7
-
-void CPU::rst_08()
-{
-	push(PC);
-	PC = 0x08;
-} // 0xCF
-
-void CPU::rst_10()
-{
-	push(PC);
-	PC = 0x10;
-} // 0xD7
-
-void CPU::rst_18()
-{
-	push(PC);
-	PC = 0x18;
-} // 0xDF
-
-void CPU::rst_20()
-{
-	push(PC);
-	PC = 0x20;
-} // 0xE7
-
-void CPU::rst_28()
-{
-	push(PC);
-	PC = 0x28;
-} // 0xEF
-
-void CPU::rst_30()
-{
-	push(PC);
-	PC = 0x30;
-} // 0xF7
-
-void CPU::rst_38()
+template <u8 n> void CPU::rst()
 {
-	push(PC);
-	PC = 0x38;
-} // 0xFF
+	push16(PC);
+	PC = n;
+} // 0xC7 | n
 
 /************************************
  * Section 3.3.11, p. 108: Returns  *
@@ -3014,34 +1274,112 @@ void CPU::ret()
 	PC = pop16();
 } // 0xC9
 
-void CPU::ret_nz()
-{
-	if (!flags.z)
-		ret();
-} // 0xC0
-
-void CPU::ret_z()
-{
-	if (flags.z)
-		ret();
-} // 0xC8
-
-void CPU::ret_nc()
-{
-	if (!flags.c)
-		ret();
-} // 0xD0
-
-void CPU::ret_c()
+template <u8 cc> void CPU::ret_cc()
 {
-	if (flags.c)
+	if (cond<cc>()) {
 		ret();
-} // 0xD8
+		cycles += 3;
+	}
+} // 0xC0 | cc << 3
 
 void CPU::reti()
 {
 	ret();
 	interruptable_ = true;
+	sched.schedule(Scheduler::irq, cycles);
 } // 0xD9
 
+/***********************************************
+************* Dispatch Tables ******************
+***********************************************/
+
+/* Apply f to every index 0 .. N-1 as a compile-time constant */
+template <u8 N, typename F> static constexpr void for_each_index(F f)
+{
+	[&]<u8... i>(std::integer_sequence<u8, i...>) {
+		(f(std::integral_constant<u8, i>{}), ...);
+	}(std::make_integer_sequence<u8, N>{});
+}
+
+constexpr std::array<CPU::operation, 256> CPU::ops = [] {
+	std::array<operation, 256> t{};
+	t.fill(&CPU::nop); // unused opcodes and the 0xCB prefix
+
+	for_each_index<4>([&](auto rr) {
+		t[0x01 | rr << 4] = &CPU::ld_rr_nn<rr>;
+		t[0x03 | rr << 4] = &CPU::inc_rr<rr>;
+		t[0x09 | rr << 4] = &CPU::add_hl_rr<rr>;
+		t[0x0B | rr << 4] = &CPU::dec_rr<rr>;
+		t[0xC1 | rr << 4] = &CPU::pop_rr<rr>;
+		t[0xC5 | rr << 4] = &CPU::push_rr<rr>;
+	});
+	for_each_index<8>([&](auto r) {
+		t[0x04 | r << 3] = &CPU::inc_r<r>;
+		t[0x05 | r << 3] = &CPU::dec_r<r>;
+		t[0x06 | r << 3] = &CPU::ld_r_n<r>;
+		t[0xC6 | r << 3] = &CPU::alu_a_n<r>;
+		t[0xC7 | r << 3] = &CPU::rst<(r << 3)>;
+	});
+	for_each_index<64>([&](auto i) {
+		t[0x40 | i] = &CPU::ld_r_r<(i >> 3), (i & 7)>;
+		t[0x80 | i] = &CPU::alu_a_r<(i >> 3), (i & 7)>;
+	});
+	for_each_index<4>([&](auto cc) {
+		t[0x20 | cc << 3] = &CPU::jr_cc_n<cc>;
+		t[0xC0 | cc << 3] = &CPU::ret_cc<cc>;
+		t[0xC2 | cc << 3] = &CPU::jp_cc_nn<cc>;
+		t[0xC4 | cc << 3] = &CPU::call_cc_nn<cc>;
+	});
+
+	t[0x02] = &CPU::ld_bc_a;
+	t[0x07] = &CPU::rlca;
+	t[0x08] = &CPU::ld_nn_sp;
+	t[0x0A] = &CPU::ld_a_bc;
+	t[0x0F] = &CPU::rrca;
+	t[0x10] = &CPU::stop;
+	t[0x12] = &CPU::ld_de_a;
+	t[0x17] = &CPU::rla;
+	t[0x18] = &CPU::jr_n;
+	t[0x1A] = &CPU::ld_a_de;
+	t[0x1F] = &CPU::rra;
+	t[0x22] = &CPU::ld_hli_a;
+	t[0x27] = &CPU::daa;
+	t[0x2A] = &CPU::ld_a_hli;
+	t[0x2F] = &CPU::cpl;
+	t[0x32] = &CPU::ld_hld_a;
+	t[0x37] = &CPU::scf;
+	t[0x3A] = &CPU::ld_a_hld;
+	t[0x3F] = &CPU::ccf;
+	t[0x76] = &CPU::halt;
+	t[0xC3] = &CPU::jp_nn;
+	t[0xC9] = &CPU::ret;
+	t[0xCD] = &CPU::call_nn;
+	t[0xD9] = &CPU::reti;
+	t[0xE0] = &CPU::ldh_n_a;
+	t[0xE2] = &CPU::ldh_c_a;
+	t[0xE8] = &CPU::add_sp_n;
+	t[0xE9] = &CPU::jp_hl;
+	t[0xEA] = &CPU::ld_nn_a;
+	t[0xF0] = &CPU::ldh_a_n;
+	t[0xF2] = &CPU::ldh_a_c;
+	t[0xF3] = &CPU::di;
+	t[0xF8] = &CPU::ldhl_sp_n;
+	t[0xF9] = &CPU::ld_sp_hl;
+	t[0xFA] = &CPU::ld_a_nn;
+	t[0xFB] = &CPU::ei;
+	return t;
+}();
+
+constexpr std::array<CPU::operation, 256> CPU::cb_ops = [] {
+	std::array<operation, 256> t{};
+
+	for_each_index<64>([&](auto i) {
+		t[0x00 | i] = &CPU::shift_r<(i >> 3), (i & 7)>;
+		t[0x40 | i] = &CPU::bit_r<(i >> 3), (i & 7)>;
+		t[0x80 | i] = &CPU::res_r<(i >> 3), (i & 7)>;
+		t[0xC0 | i] = &CPU::set_r<(i >> 3), (i & 7)>;
+	});
+	return t;
+}();
+
 } // namespace mboy
@@ -1,503 +1,123 @@
 #include <cpu.hpp>
+#include <instruction.hpp>
 
-void mboy::CPU::init_opcodes()
+#include <initializer_list>
+
+namespace mboy
+{
+/* Operand names in the order the opcode bits encode them, see cpu.hpp */
+static constexpr const char *r8_names[] = { "b", "c", "d", "e", "h", "l", "hl_ref", "a" };
+static constexpr const char *ld_names[] = { "b", "c", "d", "e", "h", "l", "hl", "a" };
+static constexpr const char *r16_names[] = { "bc", "de", "hl", "sp" };
+static constexpr const char *stack_names[] = { "bc", "de", "hl", "af" };
+static constexpr const char *cc_names[] = { "nz", "z", "nc", "c" };
+static constexpr const char *alu_names[] = { "add", "adc", "sub", "sbc", "and", "xor", "or", "cp" };
+static constexpr const char *shift_names[] = { "rlc", "rrc", "rl", "rr", "sla", "sra", "swap", "srl" };
+static constexpr const char *bit_names[] = { "0", "1", "2", "3", "4", "5", "6", "7" };
+static constexpr const char *rst_names[] = { "00", "08", "10", "18", "20", "28", "30", "38" };
+
+/* Build an entry named after its parts joined by '_', e.g. {"ld", "b", "c"} -> "ld_b_c" */
+static constexpr Instruction op(u16 opcode, u8 num_args, std::initializer_list<const char *> parts)
 {
-	opcode[0x6] = CPU::Instruction("ld_b_n", 0x6, &CPU::ld_b_n, 1);
-	opcode[0xE] = CPU::Instruction("ld_c_n", 0xE, &CPU::ld_c_n, 1);
-	opcode[0x16] = CPU::Instruction("ld_d_n", 0x16, &CPU::ld_d_n, 1);
-	opcode[0x1E] = CPU::Instruction("ld_e_n", 0x1E, &CPU::ld_e_n, 1);
-	opcode[0x26] = CPU::Instruction("ld_h_n", 0x26, &CPU::ld_h_n, 1);
-	opcode[0x2E] = CPU::Instruction("ld_l_n", 0x2E, &CPU::ld_l_n, 1);
-	opcode[0x7F] = CPU::Instruction("ld_a_a", 0x7F, &CPU::ld_a_a, 0);
-	opcode[0x47] = CPU::Instruction("ld_b_a", 0x47, &CPU::ld_b_a, 0);
-	opcode[0x4F] = CPU::Instruction("ld_c_a", 0x4F, &CPU::ld_c_a, 0);
-	opcode[0x57] = CPU::Instruction("ld_d_a", 0x57, &CPU::ld_d_a, 0);
-	opcode[0x5F] = CPU::Instruction("ld_e_a", 0x5F, &CPU::ld_e_a, 0);
-	opcode[0x67] = CPU::Instruction("ld_h_a", 0x67, &CPU::ld_h_a, 0);
-	opcode[0x6F] = CPU::Instruction("ld_l_a", 0x6F, &CPU::ld_l_a, 0);
-	opcode[0x78] = CPU::Instruction("ld_a_b", 0x78, &CPU::ld_a_b, 0);
-	opcode[0x79] = CPU::Instruction("ld_a_c", 0x79, &CPU::ld_a_c, 0);
-	opcode[0x7A] = CPU::Instruction("ld_a_d", 0x7A, &CPU::ld_a_d, 0);
-	opcode[0x7B] = CPU::Instruction("ld_a_e", 0x7B, &CPU::ld_a_e, 0);
-	opcode[0x7C] = CPU::Instruction("ld_a_h", 0x7C, &CPU::ld_a_h, 0);
-	opcode[0x7D] = CPU::Instruction("ld_a_l", 0x7D, &CPU::ld_a_l, 0);
-	opcode[0x40] = CPU::Instruction("ld_b_b", 0x40, &CPU::ld_b_b, 0);
-	opcode[0x41] = CPU::Instruction("ld_b_c", 0x41, &CPU::ld_b_c, 0);
-	opcode[0x42] = CPU::Instruction("ld_b_d", 0x42, &CPU::ld_b_d, 0);
-	opcode[0x43] = CPU::Instruction("ld_b_e", 0x43, &CPU::ld_b_e, 0);
-	opcode[0x44] = CPU::Instruction("ld_b_h", 0x44, &CPU::ld_b_h, 0);
-	opcode[0x45] = CPU::Instruction("ld_b_l", 0x45, &CPU::ld_b_l, 0);
-	opcode[0x48] = CPU::Instruction("ld_c_b", 0x48, &CPU::ld_c_b, 0);
-	opcode[0x49] = CPU::Instruction("ld_c_c", 0x49, &CPU::ld_c_c, 0);
-	opcode[0x4A] = CPU::Instruction("ld_c_d", 0x4A, &CPU::ld_c_d, 0);
-	opcode[0x4B] = CPU::Instruction("ld_c_e", 0x4B, &CPU::ld_c_e, 0);
-	opcode[0x4C] = CPU::Instruction("ld_c_h", 0x4C, &CPU::ld_c_h, 0);
-	opcode[0x4D] = CPU::Instruction("ld_c_l", 0x4D, &CPU::ld_c_l, 0);
-	opcode[0x50] = CPU::Instruction("ld_d_b", 0x50, &CPU::ld_d_b, 0);
-	opcode[0x51] = CPU::Instruction("ld_d_c", 0x51, &CPU::ld_d_c, 0);
-	opcode[0x52] = CPU::Instruction("ld_d_d", 0x52, &CPU::ld_d_d, 0);
-	opcode[0x53] = CPU::Instruction("ld_d_e", 0x53, &CPU::ld_d_e, 0);
-	opcode[0x54] = CPU::Instruction("ld_d_h", 0x54, &CPU::ld_d_h, 0);
-	opcode[0x55] = CPU::Instruction("ld_d_l", 0x55, &CPU::ld_d_l, 0);
-	opcode[0x58] = CPU::Instruction("ld_e_b", 0x58, &CPU::ld_e_b, 0);
-	opcode[0x59] = CPU::Instruction("ld_e_c", 0x59, &CPU::ld_e_c, 0);
-	opcode[0x5A] = CPU::Instruction("ld_e_d", 0x5A, &CPU::ld_e_d, 0);
-	opcode[0x5B] = CPU::Instruction("ld_e_e", 0x5B, &CPU::ld_e_e, 0);
-	opcode[0x5C] = CPU::Instruction("ld_e_h", 0x5C, &CPU::ld_e_h, 0);
-	opcode[0x5D] = CPU::Instruction("ld_e_l", 0x5D, &CPU::ld_e_l, 0);
-	opcode[0x60] = CPU::Instruction("ld_h_b", 0x60, &CPU::ld_h_b, 0);
-	opcode[0x61] = CPU::Instruction("ld_h_c", 0x61, &CPU::ld_h_c, 0);
-	opcode[0x62] = CPU::Instruction("ld_h_d", 0x62, &CPU::ld_h_d, 0);
-	opcode[0x63] = CPU::Instruction("ld_h_e", 0x63, &CPU::ld_h_e, 0);
-	opcode[0x64] = CPU::Instruction("ld_h_h", 0x64, &CPU::ld_h_h, 0);
-	opcode[0x65] = CPU::Instruction("ld_h_l", 0x65, &CPU::ld_h_l, 0);
-	opcode[0x68] = CPU::Instruction("ld_l_b", 0x68, &CPU::ld_l_b, 0);
-	opcode[0x69] = CPU::Instruction("ld_l_c", 0x69, &CPU::ld_l_c, 0);
-	opcode[0x6A] = CPU::Instruction("ld_l_d", 0x6A, &CPU::ld_l_d, 0);
-	opcode[0x6B] = CPU::Instruction("ld_l_e", 0x6B, &CPU::ld_l_e, 0);
-	opcode[0x6C] = CPU::Instruction("ld_l_h", 0x6C, &CPU::ld_l_h, 0);
-	opcode[0x6D] = CPU::Instruction("ld_l_l", 0x6D, &CPU::ld_l_l, 0);
-	opcode[0x7E] = CPU::Instruction("ld_a_hl", 0x7E, &CPU::ld_a_hl, 0);
-	opcode[0x46] = CPU::Instruction("ld_b_hl", 0x46, &CPU::ld_b_hl, 0);
-	opcode[0x4E] = CPU::Instruction("ld_c_hl", 0x4E, &CPU::ld_c_hl, 0);
-	opcode[0x56] = CPU::Instruction("ld_d_hl", 0x56, &CPU::ld_d_hl, 0);
-	opcode[0x5E] = CPU::Instruction("ld_e_hl", 0x5E, &CPU::ld_e_hl, 0);
-	opcode[0x66] = CPU::Instruction("ld_h_hl", 0x66, &CPU::ld_h_hl, 0);
-	opcode[0x6E] = CPU::Instruction("ld_l_hl", 0x6E, &CPU::ld_l_hl, 0);
-	opcode[0x77] = CPU::Instruction("ld_hl_a", 0x77, &CPU::ld_hl_a, 0);
-	opcode[0x70] = CPU::Instruction("ld_hl_b", 0x70, &CPU::ld_hl_b, 0);
-	opcode[0x71] = CPU::Instruction("ld_hl_c", 0x71, &CPU::ld_hl_c, 0);
-	opcode[0x72] = CPU::Instruction("ld_hl_d", 0x72, &CPU::ld_hl_d, 0);
-	opcode[0x73] = CPU::Instruction("ld_hl_e", 0x73, &CPU::ld_hl_e, 0);
-	opcode[0x74] = CPU::Instruction("ld_hl_h", 0x74, &CPU::ld_hl_h, 0);
-	opcode[0x75] = CPU::Instruction("ld_hl_l", 0x75, &CPU::ld_hl_l, 0);
-	opcode[0x36] = CPU::Instruction("ld_hl_n", 0x36, &CPU::ld_hl_n, 1);
-	opcode[0xA] = CPU::Instruction("ld_a_bc", 0xA, &CPU::ld_a_bc, 0);
-	opcode[0x1A] = CPU::Instruction("ld_a_de", 0x1A, &CPU::ld_a_de, 0);
-	opcode[0xFA] = CPU::Instruction("ld_a_nn", 0xFA, &CPU::ld_a_nn, 2);
-	opcode[0x3E] = CPU::Instruction("ld_a_n", 0x3E, &CPU::ld_a_n, 1);
-	opcode[0x2] = CPU::Instruction("ld_bc_a", 0x2, &CPU::ld_bc_a, 0);
-	opcode[0x12] = CPU::Instruction("ld_de_a", 0x12, &CPU::ld_de_a, 0);
-	opcode[0xEA] = CPU::Instruction("ld_nn_a", 0xEA, &CPU::ld_nn_a, 2);
-	opcode[0xE2] = CPU::Instruction("ldh_c_a", 0xE2, &CPU::ldh_c_a, 0);
-	opcode[0xF2] = CPU::Instruction("ldh_a_c", 0xF2, &CPU::ldh_a_c, 0);
-	opcode[0x3A] = CPU::Instruction("ld_a_hld", 0x3A, &CPU::ld_a_hld, 0);
-	opcode[0x32] = CPU::Instruction("ld_hld_a", 0x32, &CPU::ld_hld_a, 0);
-	opcode[0x2A] = CPU::Instruction("ld_a_hli", 0x2A, &CPU::ld_a_hli, 0);
-	opcode[0x22] = CPU::Instruction("ld_hli_a", 0x22, &CPU::ld_hli_a, 0);
-	opcode[0xE0] = CPU::Instruction("ldh_n_a", 0xE0, &CPU::ldh_n_a, 1);
-	opcode[0xF0] = CPU::Instruction("ldh_a_n", 0xF0, &CPU::ldh_a_n, 1);
-	opcode[0x1] = CPU::Instruction("ld_bc_nn", 0x1, &CPU::ld_bc_nn, 2);
-	opcode[0x11] = CPU::Instruction("ld_de_nn", 0x11, &CPU::ld_de_nn, 2);
-	opcode[0x21] = CPU::Instruction("ld_hl_nn", 0x21, &CPU::ld_hl_nn, 2);
-	opcode[0x31] = CPU::Instruction("ld_sp_nn", 0x31, &CPU::ld_sp_nn, 2);
-	opcode[0xF9] = CPU::Instruction("ld_sp_hl", 0xF9, &CPU::ld_sp_hl, 0);
-	opcode[0x8] = CPU::Instruction("ldhl_sp_n", 0x8, &CPU::ldhl_sp_n, 1);
-	opcode[0xF5] = CPU::Instruction("push_af", 0xF5, &CPU::push_af, 0);
-	opcode[0xC5] = CPU::Instruction("push_bc", 0xC5, &CPU::push_bc, 0);
-	opcode[0xD5] = CPU::Instruction("push_de", 0xD5, &CPU::push_de, 0);
-	opcode[0xE5] = CPU::Instruction("push_hl", 0xE5, &CPU::push_hl, 0);
-	opcode[0xF1] = CPU::Instruction("pop_af", 0xF1, &CPU::pop_af, 0);
-	opcode[0xC1] = CPU::Instruction("pop_bc", 0xC1, &CPU::pop_bc, 0);
-	opcode[0xD1] = CPU::Instruction("pop_de", 0xD1, &CPU::pop_de, 0);
-	opcode[0xE1] = CPU::Instruction("pop_hl", 0xE1, &CPU::pop_hl, 0);
-	opcode[0x87] = CPU::Instruction("add_a_a", 0x87, &CPU::add_a_a, 0);
-	opcode[0x80] = CPU::Instruction("add_a_b", 0x80, &CPU::add_a_b, 0);
-	opcode[0x81] = CPU::Instruction("add_a_c", 0x81, &CPU::add_a_c, 0);
-	opcode[0x82] = CPU::Instruction("add_a_d", 0x82, &CPU::add_a_d, 0);
-	opcode[0x83] = CPU::Instruction("add_a_e", 0x83, &CPU::add_a_e, 0);
-	opcode[0x84] = CPU::Instruction("add_a_h", 0x84, &CPU::add_a_h, 0);
-	opcode[0x85] = CPU::Instruction("add_a_l", 0x85, &CPU::add_a_l, 0);
-	opcode[0x86] = CPU::Instruction("add_a_hl_ref", 0x86, &CPU::add_a_hl_ref, 0);
-	opcode[0xC6] = CPU::Instruction("add_a_n", 0xC6, &CPU::add_a_n, 1);
-	opcode[0x8F] = CPU::Instruction("adc_a_a", 0x8F, &CPU::adc_a_a, 0);
-	opcode[0x88] = CPU::Instruction("adc_a_b", 0x88, &CPU::adc_a_b, 0);
-	opcode[0x89] = CPU::Instruction("adc_a_c", 0x89, &CPU::adc_a_c, 0);
-	opcode[0x8A] = CPU::Instruction("adc_a_d", 0x8A, &CPU::adc_a_d, 0);
-	opcode[0x8B] = CPU::Instruction("adc_a_e", 0x8B, &CPU::adc_a_e, 0);
-	opcode[0x8C] = CPU::Instruction("adc_a_h", 0x8C, &CPU::adc_a_h, 0);
-	opcode[0x8D] = CPU::Instruction("adc_a_l", 0x8D, &CPU::adc_a_l, 0);
-	opcode[0x8E] = CPU::Instruction("adc_a_hl_ref", 0x8E, &CPU::adc_a_hl_ref, 0);
-	opcode[0xCE] = CPU::Instruction("adc_a_n", 0xCE, &CPU::adc_a_n, 1);
-	opcode[0x97] = CPU::Instruction("sub_a_a", 0x97, &CPU::sub_a_a, 0);
-	opcode[0x90] = CPU::Instruction("sub_a_b", 0x90, &CPU::sub_a_b, 0);
-	opcode[0x91] = CPU::Instruction("sub_a_c", 0x91, &CPU::sub_a_c, 0);
-	opcode[0x92] = CPU::Instruction("sub_a_d", 0x92, &CPU::sub_a_d, 0);
-	opcode[0x93] = CPU::Instruction("sub_a_e", 0x93, &CPU::sub_a_e, 0);
-	opcode[0x94] = CPU::Instruction("sub_a_h", 0x94, &CPU::sub_a_h, 0);
-	opcode[0x95] = CPU::Instruction("sub_a_l", 0x95, &CPU::sub_a_l, 0);
-	opcode[0x96] = CPU::Instruction("sub_a_hl_ref", 0x96, &CPU::sub_a_hl_ref, 0);
-	opcode[0xD6] = CPU::Instruction("sub_a_n", 0xD6, &CPU::sub_a_n, 1);
-	opcode[0x9F] = CPU::Instruction("sbc_a_a", 0x9F, &CPU::sbc_a_a, 0);
-	opcode[0x98] = CPU::Instruction("sbc_a_b", 0x98, &CPU::sbc_a_b, 0);
-	opcode[0x99] = CPU::Instruction("sbc_a_c", 0x99, &CPU::sbc_a_c, 0);
-	opcode[0x9A] = CPU::Instruction("sbc_a_d", 0x9A, &CPU::sbc_a_d, 0);
-	opcode[0x9B] = CPU::Instruction("sbc_a_e", 0x9B, &CPU::sbc_a_e, 0);
-	opcode[0x9C] = CPU::Instruction("sbc_a_h", 0x9C, &CPU::sbc_a_h, 0);
-	opcode[0x9D] = CPU::Instruction("sbc_a_l", 0x9D, &CPU::sbc_a_l, 0);
-	opcode[0x9E] = CPU::Instruction("sbc_a_hl_ref", 0x9E, &CPU::sbc_a_hl_ref, 0);
-	opcode[0xDE] = CPU::Instruction("sbc_a_n", 0xDE, &CPU::sbc_a_n, 1);
-	opcode[0xA7] = CPU::Instruction("and_a_a", 0xA7, &CPU::and_a_a, 0);
-	opcode[0xA0] = CPU::Instruction("and_a_b", 0xA0, &CPU::and_a_b, 0);
-	opcode[0xA1] = CPU::Instruction("and_a_c", 0xA1, &CPU::and_a_c, 0);
-	opcode[0xA2] = CPU::Instruction("and_a_d", 0xA2, &CPU::and_a_d, 0);
-	opcode[0xA3] = CPU::Instruction("and_a_e", 0xA3, &CPU::and_a_e, 0);
-	opcode[0xA4] = CPU::Instruction("and_a_h", 0xA4, &CPU::and_a_h, 0);
-	opcode[0xA5] = CPU::Instruction("and_a_l", 0xA5, &CPU::and_a_l, 0);
-	opcode[0xA6] = CPU::Instruction("and_a_hl_ref", 0xA6, &CPU::and_a_hl_ref, 0);
-	opcode[0xE6] = CPU::Instruction("and_a_n", 0xE6, &CPU::and_a_n, 1);
-	opcode[0xB7] = CPU::Instruction("or_a_a", 0xB7, &CPU::or_a_a, 0);
-	opcode[0xB0] = CPU::Instruction("or_a_b", 0xB0, &CPU::or_a_b, 0);
-	opcode[0xB1] = CPU::Instruction("or_a_c", 0xB1, &CPU::or_a_c, 0);
-	opcode[0xB2] = CPU::Instruction("or_a_d", 0xB2, &CPU::or_a_d, 0);
-	opcode[0xB3] = CPU::Instruction("or_a_e", 0xB3, &CPU::or_a_e, 0);
-	opcode[0xB4] = CPU::Instruction("or_a_h", 0xB4, &CPU::or_a_h, 0);
-	opcode[0xB5] = CPU::Instruction("or_a_l", 0xB5, &CPU::or_a_l, 0);
-	opcode[0xB6] = CPU::Instruction("or_a_hl_ref", 0xB6, &CPU::or_a_hl_ref, 0);
-	opcode[0xF6] = CPU::Instruction("or_a_n", 0xF6, &CPU::or_a_n, 1);
-	opcode[0xAF] = CPU::Instruction("xor_a_a", 0xAF, &CPU::xor_a_a, 0);
-	opcode[0xA8] = CPU::Instruction("xor_a_b", 0xA8, &CPU::xor_a_b, 0);
-	opcode[0xA9] = CPU::Instruction("xor_a_c", 0xA9, &CPU::xor_a_c, 0);
-	opcode[0xAA] = CPU::Instruction("xor_a_d", 0xAA, &CPU::xor_a_d, 0);
-	opcode[0xAB] = CPU::Instruction("xor_a_e", 0xAB, &CPU::xor_a_e, 0);
-	opcode[0xAC] = CPU::Instruction("xor_a_h", 0xAC, &CPU::xor_a_h, 0);
-	opcode[0xAD] = CPU::Instruction("xor_a_l", 0xAD, &CPU::xor_a_l, 0);
-	opcode[0xAE] = CPU::Instruction("xor_a_hl_ref", 0xAE, &CPU::xor_a_hl_ref, 0);
-	opcode[0xEE] = CPU::Instruction("xor_a_n", 0xEE, &CPU::xor_a_n, 1);
-	opcode[0xBF] = CPU::Instruction("cp_a_a", 0xBF, &CPU::cp_a_a, 0);
-	opcode[0xB8] = CPU::Instruction("cp_a_b", 0xB8, &CPU::cp_a_b, 0);
-	opcode[0xB9] = CPU::Instruction("cp_a_c", 0xB9, &CPU::cp_a_c, 0);
-	opcode[0xBA] = CPU::Instruction("cp_a_d", 0xBA, &CPU::cp_a_d, 0);
-	opcode[0xBB] = CPU::Instruction("cp_a_e", 0xBB, &CPU::cp_a_e, 0);
-	opcode[0xBC] = CPU::Instruction("cp_a_h", 0xBC, &CPU::cp_a_h, 0);
-	opcode[0xBD] = CPU::Instruction("cp_a_l", 0xBD, &CPU::cp_a_l, 0);
-	opcode[0xBE] = CPU::Instruction("cp_a_hl_ref", 0xBE, &CPU::cp_a_hl_ref, 0);
-	opcode[0xFE] = CPU::Instruction("cp_a_n", 0xFE, &CPU::cp_a_n, 1);
-	opcode[0x3C] = CPU::Instruction("inc_a", 0x3C, &CPU::inc_a, 0);
-	opcode[0x4] = CPU::Instruction("inc_b", 0x4, &CPU::inc_b, 0);
-	opcode[0xC] = CPU::Instruction("inc_c", 0xC, &CPU::inc_c, 0);
-	opcode[0x14] = CPU::Instruction("inc_d", 0x14, &CPU::inc_d, 0);
-	opcode[0x1C] = CPU::Instruction("inc_e", 0x1C, &CPU::inc_e, 0);
-	opcode[0x24] = CPU::Instruction("inc_h", 0x24, &CPU::inc_h, 0);
-	opcode[0x2C] = CPU::Instruction("inc_l", 0x2C, &CPU::inc_l, 0);
-	opcode[0x34] = CPU::Instruction("inc_hl_ref", 0x34, &CPU::inc_hl_ref, 0);
-	opcode[0x3D] = CPU::Instruction("dec_a", 0x3D, &CPU::dec_a, 0);
-	opcode[0x5] = CPU::Instruction("dec_b", 0x5, &CPU::dec_b, 0);
-	opcode[0xD] = CPU::Instruction("dec_c", 0xD, &CPU::dec_c, 0);
-	opcode[0x15] = CPU::Instruction("dec_d", 0x15, &CPU::dec_d, 0);
-	opcode[0x1D] = CPU::Instruction("dec_e", 0x1D, &CPU::dec_e, 0);
-	opcode[0x25] = CPU::Instruction("dec_h", 0x25, &CPU::dec_h, 0);
-	opcode[0x2D] = CPU::Instruction("dec_l", 0x2D, &CPU::dec_l, 0);
-	opcode[0x35] = CPU::Instruction("dec_hl_ref", 0x35, &CPU::dec_hl_ref, 0);
-	opcode[0x9] = CPU::Instruction("add_hl_bc", 0x9, &CPU::add_hl_bc, 0);
-	opcode[0x19] = CPU::Instruction("add_hl_de", 0x19, &CPU::add_hl_de, 0);
-	opcode[0x29] = CPU::Instruction("add_hl_hl", 0x29, &CPU::add_hl_hl, 0);
-	opcode[0x39] = CPU::Instruction("add_hl_sp", 0x39, &CPU::add_hl_sp, 0);
-	opcode[0xE8] = CPU::Instruction("add_sp_n", 0xE8, &CPU::add_sp_n, 1);
-	opcode[0x3] = CPU::Instruction("inc_bc", 0x3, &CPU::inc_bc, 0);
-	opcode[0x13] = CPU::Instruction("inc_de", 0x13, &CPU::inc_de, 0);
-	opcode[0x23] = CPU::Instruction("inc_hl", 0x23, &CPU::inc_hl, 0);
-	opcode[0x33] = CPU::Instruction("inc_sp", 0x33, &CPU::inc_sp, 0);
-	opcode[0xB] = CPU::Instruction("dec_bc", 0xB, &CPU::dec_bc, 0);
-	opcode[0x1B] = CPU::Instruction("dec_de", 0x1B, &CPU::dec_de, 0);
-	opcode[0x2B] = CPU::Instruction("dec_hl", 0x2B, &CPU::dec_hl, 0);
-	opcode[0x3B] = CPU::Instruction("dec_sp", 0x3B, &CPU::dec_sp, 0);
-	opcode[0xCB37] = CPU::Instruction("swap_a", 0xCB37, &CPU::swap_a, 0);
-	opcode[0xCB30] = CPU::Instruction("swap_b", 0xCB30, &CPU::swap_b, 0);
-	opcode[0xCB31] = CPU::Instruction("swap_c", 0xCB31, &CPU::swap_c, 0);
-	opcode[0xCB32] = CPU::Instruction("swap_d", 0xCB32, &CPU::swap_d, 0);
-	opcode[0xCB33] = CPU::Instruction("swap_e", 0xCB33, &CPU::swap_e, 0);
-	opcode[0xCB34] = CPU::Instruction("swap_h", 0xCB34, &CPU::swap_h, 0);
-	opcode[0xCB35] = CPU::Instruction("swap_l", 0xCB35, &CPU::swap_l, 0);
-	opcode[0xCB36] = CPU::Instruction("swap_hl_ref", 0xCB36, &CPU::swap_hl_ref, 0);
-	opcode[0x27] = CPU::Instruction("daa", 0x27, &CPU::daa, 0);
-	opcode[0x2F] = CPU::Instruction("cpl", 0x2F, &CPU::cpl, 0);
-	opcode[0x3F] = CPU::Instruction("ccf", 0x3F, &CPU::ccf, 0);
-	opcode[0x37] = CPU::Instruction("scf", 0x37, &CPU::scf, 0);
-	opcode[0x0] = CPU::Instruction("nop", 0x0, &CPU::nop, 0);
-	opcode[0x76] = CPU::Instruction("halt", 0x76, &CPU::halt, 0);
-	opcode[0x10] = CPU::Instruction("stop", 0x10, &CPU::stop, 0);
-	opcode[0xF3] = CPU::Instruction("di", 0xF3, &CPU::di, 0);
-	opcode[0xFB] = CPU::Instruction("ei", 0xFB, &CPU::ei, 0);
-	opcode[0x7] = CPU::Instruction("rlca", 0x7, &CPU::rlca, 0);
-	opcode[0x17] = CPU::Instruction("rla", 0x17, &CPU::rla, 0);
-	opcode[0xF] = CPU::Instruction("rrca", 0xF, &CPU::rrca, 0);
-	opcode[0xCB07] = CPU::Instruction("rlc_a", 0xCB07, &CPU::rlc_a, 0);
-	opcode[0xCB00] = CPU::Instruction("rlc_b", 0xCB00, &CPU::rlc_b, 0);
-	opcode[0xCB01] = CPU::Instruction("rlc_c", 0xCB01, &CPU::rlc_c, 0);
-	opcode[0xCB02] = CPU::Instruction("rlc_d", 0xCB02, &CPU::rlc_d, 0);
-	opcode[0xCB03] = CPU::Instruction("rlc_e", 0xCB03, &CPU::rlc_e, 0);
-	opcode[0xCB04] = CPU::Instruction("rlc_h", 0xCB04, &CPU::rlc_h, 0);
-	opcode[0xCB05] = CPU::Instruction("rlc_l", 0xCB05, &CPU::rlc_l, 0);
-	opcode[0xCB06] = CPU::Instruction("rlc_hl_ref", 0xCB06, &CPU::rlc_hl_ref, 0);
-	opcode[0xCB17] = CPU::Instruction("rl_a", 0xCB17, &CPU::rl_a, 0);
-	opcode[0xCB10] = CPU::Instruction("rl_b", 0xCB10, &CPU::rl_b, 0);
-	opcode[0xCB11] = CPU::Instruction("rl_c", 0xCB11, &CPU::rl_c, 0);
-	opcode[0xCB12] = CPU::Instruction("rl_d", 0xCB12, &CPU::rl_d, 0);
-	opcode[0xCB13] = CPU::Instruction("rl_e", 0xCB13, &CPU::rl_e, 0);
-	opcode[0xCB14] = CPU::Instruction("rl_h", 0xCB14, &CPU::rl_h, 0);
-	opcode[0xCB15] = CPU::Instruction("rl_l", 0xCB15, &CPU::rl_l, 0);
-	opcode[0xCB16] = CPU::Instruction("rl_hl_ref", 0xCB16, &CPU::rl_hl_ref, 0);
-	opcode[0xCB0F] = CPU::Instruction("rrc_a", 0xCB0F, &CPU::rrc_a, 0);
-	opcode[0xCB08] = CPU::Instruction("rrc_b", 0xCB08, &CPU::rrc_b, 0);
-	opcode[0xCB09] = CPU::Instruction("rrc_c", 0xCB09, &CPU::rrc_c, 0);
-	opcode[0xCB0A] = CPU::Instruction("rrc_d", 0xCB0A, &CPU::rrc_d, 0);
-	opcode[0xCB0B] = CPU::Instruction("rrc_e", 0xCB0B, &CPU::rrc_e, 0);
-	opcode[0xCB0C] = CPU::Instruction("rrc_h", 0xCB0C, &CPU::rrc_h, 0);
-	opcode[0xCB0D] = CPU::Instruction("rrc_l", 0xCB0D, &CPU::rrc_l, 0);
-	opcode[0xCB0E] = CPU::Instruction("rrc_hl_ref", 0xCB0E, &CPU::rrc_hl_ref, 0);
-	opcode[0xCB1F] = CPU::Instruction("rr_a", 0xCB1F, &CPU::rr_a, 0);
-	opcode[0xCB18] = CPU::Instruction("rr_b", 0xCB18, &CPU::rr_b, 0);
-	opcode[0xCB19] = CPU::Instruction("rr_c", 0xCB19, &CPU::rr_c, 0);
-	opcode[0xCB1A] = CPU::Instruction("rr_d", 0xCB1A, &CPU::rr_d, 0);
-	opcode[0xCB1B] = CPU::Instruction("rr_e", 0xCB1B, &CPU::rr_e, 0);
-	opcode[0xCB1C] = CPU::Instruction("rr_h", 0xCB1C, &CPU::rr_h, 0);
-	opcode[0xCB1D] = CPU::Instruction("rr_l", 0xCB1D, &CPU::rr_l, 0);
-	opcode[0xCB1E] = CPU::Instruction("rr_hl_ref", 0xCB1E, &CPU::rr_hl_ref, 0);
-	opcode[0xCB27] = CPU::Instruction("sla_a", 0xCB27, &CPU::sla_a, 0);
-	opcode[0xCB20] = CPU::Instruction("sla_b", 0xCB20, &CPU::sla_b, 0);
-	opcode[0xCB21] = CPU::Instruction("sla_c", 0xCB21, &CPU::sla_c, 0);
-	opcode[0xCB22] = CPU::Instruction("sla_d", 0xCB22, &CPU::sla_d, 0);
-	opcode[0xCB23] = CPU::Instruction("sla_e", 0xCB23, &CPU::sla_e, 0);
-	opcode[0xCB24] = CPU::Instruction("sla_h", 0xCB24, &CPU::sla_h, 0);
-	opcode[0xCB25] = CPU::Instruction("sla_l", 0xCB25, &CPU::sla_l, 0);
-	opcode[0xCB26] = CPU::Instruction("sla_hl_ref", 0xCB26, &CPU::sla_hl_ref, 0);
-	opcode[0xCB2F] = CPU::Instruction("sra_a", 0xCB2F, &CPU::sra_a, 0);
-	opcode[0xCB28] = CPU::Instruction("sra_b", 0xCB28, &CPU::sra_b, 0);
-	opcode[0xCB29] = CPU::Instruction("sra_c", 0xCB29, &CPU::sra_c, 0);
-	opcode[0xCB2A] = CPU::Instruction("sra_d", 0xCB2A, &CPU::sra_d, 0);
-	opcode[0xCB2B] = CPU::Instruction("sra_e", 0xCB2B, &CPU::sra_e, 0);
-	opcode[0xCB2C] = CPU::Instruction("sra_h", 0xCB2C, &CPU::sra_h, 0);
-	opcode[0xCB2D] = CPU::Instruction("sra_l", 0xCB2D, &CPU::sra_l, 0);
-	opcode[0xCB2E] = CPU::Instruction("sra_hl_ref", 0xCB2E, &CPU::sra_hl_ref, 0);
-	opcode[0xCB3F] = CPU::Instruction("srl_a", 0xCB3F, &CPU::srl_a, 0);
-	opcode[0xCB38] = CPU::Instruction("srl_b", 0xCB38, &CPU::srl_b, 0);
-	opcode[0xCB39] = CPU::Instruction("srl_c", 0xCB39, &CPU::srl_c, 0);
-	opcode[0xCB3A] = CPU::Instruction("srl_d", 0xCB3A, &CPU::srl_d, 0);
-	opcode[0xCB3B] = CPU::Instruction("srl_e", 0xCB3B, &CPU::srl_e, 0);
-	opcode[0xCB3C] = CPU::Instruction("srl_h", 0xCB3C, &CPU::srl_h, 0);
-	opcode[0xCB3D] = CPU::Instruction("srl_l", 0xCB3D, &CPU::srl_l, 0);
-	opcode[0xCB3E] = CPU::Instruction("srl_hl_ref", 0xCB3E, &CPU::srl_hl_ref, 0);
-	opcode[0xCB47] = CPU::Instruction("bit_a_0", 0xCB47, &CPU::bit_a_0, 0);
-	opcode[0xCB40] = CPU::Instruction("bit_b_0", 0xCB40, &CPU::bit_b_0, 0);
-	opcode[0xCB41] = CPU::Instruction("bit_c_0", 0xCB41, &CPU::bit_c_0, 0);
-	opcode[0xCB42] = CPU::Instruction("bit_d_0", 0xCB42, &CPU::bit_d_0, 0);
-	opcode[0xCB43] = CPU::Instruction("bit_e_0", 0xCB43, &CPU::bit_e_0, 0);
-	opcode[0xCB44] = CPU::Instruction("bit_h_0", 0xCB44, &CPU::bit_h_0, 0);
-	opcode[0xCB45] = CPU::Instruction("bit_l_0", 0xCB45, &CPU::bit_l_0, 0);
-	opcode[0xCB46] = CPU::Instruction("bit_hl_ref_0", 0xCB46, &CPU::bit_hl_ref_0, 0);
-	opcode[0xCB4F] = CPU::Instruction("bit_a_1", 0xCB4F, &CPU::bit_a_1, 0);
-	opcode[0xCB48] = CPU::Instruction("bit_b_1", 0xCB48, &CPU::bit_b_1, 0);
-	opcode[0xCB49] = CPU::Instruction("bit_c_1", 0xCB49, &CPU::bit_c_1, 0);
-	opcode[0xCB4A] = CPU::Instruction("bit_d_1", 0xCB4A, &CPU::bit_d_1, 0);
-	opcode[0xCB4B] = CPU::Instruction("bit_e_1", 0xCB4B, &CPU::bit_e_1, 0);
-	opcode[0xCB4C] = CPU::Instruction("bit_h_1", 0xCB4C, &CPU::bit_h_1, 0);
-	opcode[0xCB4D] = CPU::Instruction("bit_l_1", 0xCB4D, &CPU::bit_l_1, 0);
-	opcode[0xCB4E] = CPU::Instruction("bit_hl_ref_1", 0xCB4E, &CPU::bit_hl_ref_1, 0);
-	opcode[0xCB57] = CPU::Instruction("bit_a_2", 0xCB57, &CPU::bit_a_2, 0);
-	opcode[0xCB50] = CPU::Instruction("bit_b_2", 0xCB50, &CPU::bit_b_2, 0);
-	opcode[0xCB51] = CPU::Instruction("bit_c_2", 0xCB51, &CPU::bit_c_2, 0);
-	opcode[0xCB52] = CPU::Instruction("bit_d_2", 0xCB52, &CPU::bit_d_2, 0);
-	opcode[0xCB53] = CPU::Instruction("bit_e_2", 0xCB53, &CPU::bit_e_2, 0);
-	opcode[0xCB54] = CPU::Instruction("bit_h_2", 0xCB54, &CPU::bit_h_2, 0);
-	opcode[0xCB55] = CPU::Instruction("bit_l_2", 0xCB55, &CPU::bit_l_2, 0);
-	opcode[0xCB56] = CPU::Instruction("bit_hl_ref_2", 0xCB56, &CPU::bit_hl_ref_2, 0);
-	opcode[0xCB5F] = CPU::Instruction("bit_a_3", 0xCB5F, &CPU::bit_a_3, 0);
-	opcode[0xCB58] = CPU::Instruction("bit_b_3", 0xCB58, &CPU::bit_b_3, 0);
-	opcode[0xCB59] = CPU::Instruction("bit_c_3", 0xCB59, &CPU::bit_c_3, 0);
-	opcode[0xCB5A] = CPU::Instruction("bit_d_3", 0xCB5A, &CPU::bit_d_3, 0);
-	opcode[0xCB5B] = CPU::Instruction("bit_e_3", 0xCB5B, &CPU::bit_e_3, 0);
-	opcode[0xCB5C] = CPU::Instruction("bit_h_3", 0xCB5C, &CPU::bit_h_3, 0);
-	opcode[0xCB5D] = CPU::Instruction("bit_l_3", 0xCB5D, &CPU::bit_l_3, 0);
-	opcode[0xCB5E] = CPU::Instruction("bit_hl_ref_3", 0xCB5E, &CPU::bit_hl_ref_3, 0);
-	opcode[0xCB67] = CPU::Instruction("bit_a_4", 0xCB67, &CPU::bit_a_4, 0);
-	opcode[0xCB60] = CPU::Instruction("bit_b_4", 0xCB60, &CPU::bit_b_4, 0);
-	opcode[0xCB61] = CPU::Instruction("bit_c_4", 0xCB61, &CPU::bit_c_4, 0);
-	opcode[0xCB62] = CPU::Instruction("bit_d_4", 0xCB62, &CPU::bit_d_4, 0);
-	opcode[0xCB63] = CPU::Instruction("bit_e_4", 0xCB63, &CPU::bit_e_4, 0);
-	opcode[0xCB64] = CPU::Instruction("bit_h_4", 0xCB64, &CPU::bit_h_4, 0);
-	opcode[0xCB65] = CPU::Instruction("bit_l_4", 0xCB65, &CPU::bit_l_4, 0);
-	opcode[0xCB66] = CPU::Instruction("bit_hl_ref_4", 0xCB66, &CPU::bit_hl_ref_4, 0);
-	opcode[0xCB6F] = CPU::Instruction("bit_a_5", 0xCB6F, &CPU::bit_a_5, 0);
-	opcode[0xCB68] = CPU::Instruction("bit_b_5", 0xCB68, &CPU::bit_b_5, 0);
-	opcode[0xCB69] = CPU::Instruction("bit_c_5", 0xCB69, &CPU::bit_c_5, 0);
-	opcode[0xCB6A] = CPU::Instruction("bit_d_5", 0xCB6A, &CPU::bit_d_5, 0);
-	opcode[0xCB6B] = CPU::Instruction("bit_e_5", 0xCB6B, &CPU::bit_e_5, 0);
-	opcode[0xCB6C] = CPU::Instruction("bit_h_5", 0xCB6C, &CPU::bit_h_5, 0);
-	opcode[0xCB6D] = CPU::Instruction("bit_l_5", 0xCB6D, &CPU::bit_l_5, 0);
-	opcode[0xCB6E] = CPU::Instruction("bit_hl_ref_5", 0xCB6E, &CPU::bit_hl_ref_5, 0);
-	opcode[0xCB77] = CPU::Instruction("bit_a_6", 0xCB77, &CPU::bit_a_6, 0);
-	opcode[0xCB70] = CPU::Instruction("bit_b_6", 0xCB70, &CPU::bit_b_6, 0);
-	opcode[0xCB71] = CPU::Instruction("bit_c_6", 0xCB71, &CPU::bit_c_6, 0);
-	opcode[0xCB72] = CPU::Instruction("bit_d_6", 0xCB72, &CPU::bit_d_6, 0);
-	opcode[0xCB73] = CPU::Instruction("bit_e_6", 0xCB73, &CPU::bit_e_6, 0);
-	opcode[0xCB74] = CPU::Instruction("bit_h_6", 0xCB74, &CPU::bit_h_6, 0);
-	opcode[0xCB75] = CPU::Instruction("bit_l_6", 0xCB75, &CPU::bit_l_6, 0);
-	opcode[0xCB76] = CPU::Instruction("bit_hl_ref_6", 0xCB76, &CPU::bit_hl_ref_6, 0);
-	opcode[0xCB7F] = CPU::Instruction("bit_a_7", 0xCB7F, &CPU::bit_a_7, 0);
-	opcode[0xCB78] = CPU::Instruction("bit_b_7", 0xCB78, &CPU::bit_b_7, 0);
-	opcode[0xCB79] = CPU::Instruction("bit_c_7", 0xCB79, &CPU::bit_c_7, 0);
-	opcode[0xCB7A] = CPU::Instruction("bit_d_7", 0xCB7A, &CPU::bit_d_7, 0);
-	opcode[0xCB7B] = CPU::Instruction("bit_e_7", 0xCB7B, &CPU::bit_e_7, 0);
-	opcode[0xCB7C] = CPU::Instruction("bit_h_7", 0xCB7C, &CPU::bit_h_7, 0);
-	opcode[0xCB7D] = CPU::Instruction("bit_l_7", 0xCB7D, &CPU::bit_l_7, 0);
-	opcode[0xCB7E] = CPU::Instruction("bit_hl_ref_7", 0xCB7E, &CPU::bit_hl_ref_7, 0);
-	opcode[0xCB87] = CPU::Instruction("res_a_0", 0xCB87, &CPU::res_a_0, 0);
-	opcode[0xCB80] = CPU::Instruction("res_b_0", 0xCB80, &CPU::res_b_0, 0);
-	opcode[0xCB81] = CPU::Instruction("res_c_0", 0xCB81, &CPU::res_c_0, 0);
-	opcode[0xCB82] = CPU::Instruction("res_d_0", 0xCB82, &CPU::res_d_0, 0);
-	opcode[0xCB83] = CPU::Instruction("res_e_0", 0xCB83, &CPU::res_e_0, 0);
-	opcode[0xCB84] = CPU::Instruction("res_h_0", 0xCB84, &CPU::res_h_0, 0);
-	opcode[0xCB85] = CPU::Instruction("res_l_0", 0xCB85, &CPU::res_l_0, 0);
-	opcode[0xCB86] = CPU::Instruction("res_hl_ref_0", 0xCB86, &CPU::res_hl_ref_0, 0);
-	opcode[0xCB8F] = CPU::Instruction("res_a_1", 0xCB8F, &CPU::res_a_1, 0);
-	opcode[0xCB88] = CPU::Instruction("res_b_1", 0xCB88, &CPU::res_b_1, 0);
-	opcode[0xCB89] = CPU::Instruction("res_c_1", 0xCB89, &CPU::res_c_1, 0);
-	opcode[0xCB8A] = CPU::Instruction("res_d_1", 0xCB8A, &CPU::res_d_1, 0);
-	opcode[0xCB8B] = CPU::Instruction("res_e_1", 0xCB8B, &CPU::res_e_1, 0);
-	opcode[0xCB8C] = CPU::Instruction("res_h_1", 0xCB8C, &CPU::res_h_1, 0);
-	opcode[0xCB8D] = CPU::Instruction("res_l_1", 0xCB8D, &CPU::res_l_1, 0);
-	opcode[0xCB8E] = CPU::Instruction("res_hl_ref_1", 0xCB8E, &CPU::res_hl_ref_1, 0);
-	opcode[0xCB97] = CPU::Instruction("res_a_2", 0xCB97, &CPU::res_a_2, 0);
-	opcode[0xCB90] = CPU::Instruction("res_b_2", 0xCB90, &CPU::res_b_2, 0);
-	opcode[0xCB91] = CPU::Instruction("res_c_2", 0xCB91, &CPU::res_c_2, 0);
-	opcode[0xCB92] = CPU::Instruction("res_d_2", 0xCB92, &CPU::res_d_2, 0);
-	opcode[0xCB93] = CPU::Instruction("res_e_2", 0xCB93, &CPU::res_e_2, 0);
-	opcode[0xCB94] = CPU::Instruction("res_h_2", 0xCB94, &CPU::res_h_2, 0);
-	opcode[0xCB95] = CPU::Instruction("res_l_2", 0xCB95, &CPU::res_l_2, 0);
-	opcode[0xCB96] = CPU::Instruction("res_hl_ref_2", 0xCB96, &CPU::res_hl_ref_2, 0);
-	opcode[0xCB9F] = CPU::Instruction("res_a_3", 0xCB9F, &CPU::res_a_3, 0);
-	opcode[0xCB98] = CPU::Instruction("res_b_3", 0xCB98, &CPU::res_b_3, 0);
-	opcode[0xCB99] = CPU::Instruction("res_c_3", 0xCB99, &CPU::res_c_3, 0);
-	opcode[0xCB9A] = CPU::Instruction("res_d_3", 0xCB9A, &CPU::res_d_3, 0);
-	opcode[0xCB9B] = CPU::Instruction("res_e_3", 0xCB9B, &CPU::res_e_3, 0);
-	opcode[0xCB9C] = CPU::Instruction("res_h_3", 0xCB9C, &CPU::res_h_3, 0);
-	opcode[0xCB9D] = CPU::Instruction("res_l_3", 0xCB9D, &CPU::res_l_3, 0);
-	opcode[0xCB9E] = CPU::Instruction("res_hl_ref_3", 0xCB9E, &CPU::res_hl_ref_3, 0);
-	opcode[0xCBA7] = CPU::Instruction("res_a_4", 0xCBA7, &CPU::res_a_4, 0);
-	opcode[0xCBA0] = CPU::Instruction("res_b_4", 0xCBA0, &CPU::res_b_4, 0);
-	opcode[0xCBA1] = CPU::Instruction("res_c_4", 0xCBA1, &CPU::res_c_4, 0);
-	opcode[0xCBA2] = CPU::Instruction("res_d_4", 0xCBA2, &CPU::res_d_4, 0);
-	opcode[0xCBA3] = CPU::Instruction("res_e_4", 0xCBA3, &CPU::res_e_4, 0);
-	opcode[0xCBA4] = CPU::Instruction("res_h_4", 0xCBA4, &CPU::res_h_4, 0);
-	opcode[0xCBA5] = CPU::Instruction("res_l_4", 0xCBA5, &CPU::res_l_4, 0);
-	opcode[0xCBA6] = CPU::Instruction("res_hl_ref_4", 0xCBA6, &CPU::res_hl_ref_4, 0);
-	opcode[0xCBAF] = CPU::Instruction("res_a_5", 0xCBAF, &CPU::res_a_5, 0);
-	opcode[0xCBA8] = CPU::Instruction("res_b_5", 0xCBA8, &CPU::res_b_5, 0);
-	opcode[0xCBA9] = CPU::Instruction("res_c_5", 0xCBA9, &CPU::res_c_5, 0);
-	opcode[0xCBAA] = CPU::Instruction("res_d_5", 0xCBAA, &CPU::res_d_5, 0);
-	opcode[0xCBAB] = CPU::Instruction("res_e_5", 0xCBAB, &CPU::res_e_5, 0);
-	opcode[0xCBAC] = CPU::Instruction("res_h_5", 0xCBAC, &CPU::res_h_5, 0);
-	opcode[0xCBAD] = CPU::Instruction("res_l_5", 0xCBAD, &CPU::res_l_5, 0);
-	opcode[0xCBAE] = CPU::Instruction("res_hl_ref_5", 0xCBAE, &CPU::res_hl_ref_5, 0);
-	opcode[0xCBB7] = CPU::Instruction("res_a_6", 0xCBB7, &CPU::res_a_6, 0);
-	opcode[0xCBB0] = CPU::Instruction("res_b_6", 0xCBB0, &CPU::res_b_6, 0);
-	opcode[0xCBB1] = CPU::Instruction("res_c_6", 0xCBB1, &CPU::res_c_6, 0);
-	opcode[0xCBB2] = CPU::Instruction("res_d_6", 0xCBB2, &CPU::res_d_6, 0);
-	opcode[0xCBB3] = CPU::Instruction("res_e_6", 0xCBB3, &CPU::res_e_6, 0);
-	opcode[0xCBB4] = CPU::Instruction("res_h_6", 0xCBB4, &CPU::res_h_6, 0);
-	opcode[0xCBB5] = CPU::Instruction("res_l_6", 0xCBB5, &CPU::res_l_6, 0);
-	opcode[0xCBB6] = CPU::Instruction("res_hl_ref_6", 0xCBB6, &CPU::res_hl_ref_6, 0);
-	opcode[0xCBBF] = CPU::Instruction("res_a_7", 0xCBBF, &CPU::res_a_7, 0);
-	opcode[0xCBB8] = CPU::Instruction("res_b_7", 0xCBB8, &CPU::res_b_7, 0);
-	opcode[0xCBB9] = CPU::Instruction("res_c_7", 0xCBB9, &CPU::res_c_7, 0);
-	opcode[0xCBBA] = CPU::Instruction("res_d_7", 0xCBBA, &CPU::res_d_7, 0);
-	opcode[0xCBBB] = CPU::Instruction("res_e_7", 0xCBBB, &CPU::res_e_7, 0);
-	opcode[0xCBBC] = CPU::Instruction("res_h_7", 0xCBBC, &CPU::res_h_7, 0);
-	opcode[0xCBBD] = CPU::Instruction("res_l_7", 0xCBBD, &CPU::res_l_7, 0);
-	opcode[0xCBBE] = CPU::Instruction("res_hl_ref_7", 0xCBBE, &CPU::res_hl_ref_7, 0);
-	opcode[0xCBC7] = CPU::Instruction("set_a_0", 0xCBC7, &CPU::set_a_0, 0);
-	opcode[0xCBC0] = CPU::Instruction("set_b_0", 0xCBC0, &CPU::set_b_0, 0);
-	opcode[0xCBC1] = CPU::Instruction("set_c_0", 0xCBC1, &CPU::set_c_0, 0);
-	opcode[0xCBC2] = CPU::Instruction("set_d_0", 0xCBC2, &CPU::set_d_0, 0);
-	opcode[0xCBC3] = CPU::Instruction("set_e_0", 0xCBC3, &CPU::set_e_0, 0);
-	opcode[0xCBC4] = CPU::Instruction("set_h_0", 0xCBC4, &CPU::set_h_0, 0);
-	opcode[0xCBC5] = CPU::Instruction("set_l_0", 0xCBC5, &CPU::set_l_0, 0);
-	opcode[0xCBC6] = CPU::Instruction("set_hl_ref_0", 0xCBC6, &CPU::set_hl_ref_0, 0);
-	opcode[0xCBCF] = CPU::Instruction("set_a_1", 0xCBCF, &CPU::set_a_1, 0);
-	opcode[0xCBC8] = CPU::Instruction("set_b_1", 0xCBC8, &CPU::set_b_1, 0);
-	opcode[0xCBC9] = CPU::Instruction("set_c_1", 0xCBC9, &CPU::set_c_1, 0);
-	opcode[0xCBCA] = CPU::Instruction("set_d_1", 0xCBCA, &CPU::set_d_1, 0);
-	opcode[0xCBCB] = CPU::Instruction("set_e_1", 0xCBCB, &CPU::set_e_1, 0);
-	opcode[0xCBCC] = CPU::Instruction("set_h_1", 0xCBCC, &CPU::set_h_1, 0);
-	opcode[0xCBCD] = CPU::Instruction("set_l_1", 0xCBCD, &CPU::set_l_1, 0);
-	opcode[0xCBCE] = CPU::Instruction("set_hl_ref_1", 0xCBCE, &CPU::set_hl_ref_1, 0);
-	opcode[0xCBD7] = CPU::Instruction("set_a_2", 0xCBD7, &CPU::set_a_2, 0);
-	opcode[0xCBD0] = CPU::Instruction("set_b_2", 0xCBD0, &CPU::set_b_2, 0);
-	opcode[0xCBD1] = CPU::Instruction("set_c_2", 0xCBD1, &CPU::set_c_2, 0);
-	opcode[0xCBD2] = CPU::Instruction("set_d_2", 0xCBD2, &CPU::set_d_2, 0);
-	opcode[0xCBD3] = CPU::Instruction("set_e_2", 0xCBD3, &CPU::set_e_2, 0);
-	opcode[0xCBD4] = CPU::Instruction("set_h_2", 0xCBD4, &CPU::set_h_2, 0);
-	opcode[0xCBD5] = CPU::Instruction("set_l_2", 0xCBD5, &CPU::set_l_2, 0);
-	opcode[0xCBD6] = CPU::Instruction("set_hl_ref_2", 0xCBD6, &CPU::set_hl_ref_2, 0);
-	opcode[0xCBDF] = CPU::Instruction("set_a_3", 0xCBDF, &CPU::set_a_3, 0);
-	opcode[0xCBD8] = CPU::Instruction("set_b_3", 0xCBD8, &CPU::set_b_3, 0);
-	opcode[0xCBD9] = CPU::Instruction("set_c_3", 0xCBD9, &CPU::set_c_3, 0);
-	opcode[0xCBDA] = CPU::Instruction("set_d_3", 0xCBDA, &CPU::set_d_3, 0);
-	opcode[0xCBDB] = CPU::Instruction("set_e_3", 0xCBDB, &CPU::set_e_3, 0);
-	opcode[0xCBDC] = CPU::Instruction("set_h_3", 0xCBDC, &CPU::set_h_3, 0);
-	opcode[0xCBDD] = CPU::Instruction("set_l_3", 0xCBDD, &CPU::set_l_3, 0);
-	opcode[0xCBDE] = CPU::Instruction("set_hl_ref_3", 0xCBDE, &CPU::set_hl_ref_3, 0);
-	opcode[0xCBE7] = CPU::Instruction("set_a_4", 0xCBE7, &CPU::set_a_4, 0);
-	opcode[0xCBE0] = CPU::Instruction("set_b_4", 0xCBE0, &CPU::set_b_4, 0);
-	opcode[0xCBE1] = CPU::Instruction("set_c_4", 0xCBE1, &CPU::set_c_4, 0);
-	opcode[0xCBE2] = CPU::Instruction("set_d_4", 0xCBE2, &CPU::set_d_4, 0);
-	opcode[0xCBE3] = CPU::Instruction("set_e_4", 0xCBE3, &CPU::set_e_4, 0);
-	opcode[0xCBE4] = CPU::Instruction("set_h_4", 0xCBE4, &CPU::set_h_4, 0);
-	opcode[0xCBE5] = CPU::Instruction("set_l_4", 0xCBE5, &CPU::set_l_4, 0);
-	opcode[0xCBE6] = CPU::Instruction("set_hl_ref_4", 0xCBE6, &CPU::set_hl_ref_4, 0);
-	opcode[0xCBEF] = CPU::Instruction("set_a_5", 0xCBEF, &CPU::set_a_5, 0);
-	opcode[0xCBE8] = CPU::Instruction("set_b_5", 0xCBE8, &CPU::set_b_5, 0);
-	opcode[0xCBE9] = CPU::Instruction("set_c_5", 0xCBE9, &CPU::set_c_5, 0);
-	opcode[0xCBEA] = CPU::Instruction("set_d_5", 0xCBEA, &CPU::set_d_5, 0);
-	opcode[0xCBEB] = CPU::Instruction("set_e_5", 0xCBEB, &CPU::set_e_5, 0);
-	opcode[0xCBEC] = CPU::Instruction("set_h_5", 0xCBEC, &CPU::set_h_5, 0);
-	opcode[0xCBED] = CPU::Instruction("set_l_5", 0xCBED, &CPU::set_l_5, 0);
-	opcode[0xCBEE] = CPU::Instruction("set_hl_ref_5", 0xCBEE, &CPU::set_hl_ref_5, 0);
-	opcode[0xCBF7] = CPU::Instruction("set_a_6", 0xCBF7, &CPU::set_a_6, 0);
-	opcode[0xCBF0] = CPU::Instruction("set_b_6", 0xCBF0, &CPU::set_b_6, 0);
-	opcode[0xCBF1] = CPU::Instruction("set_c_6", 0xCBF1, &CPU::set_c_6, 0);
-	opcode[0xCBF2] = CPU::Instruction("set_d_6", 0xCBF2, &CPU::set_d_6, 0);
-	opcode[0xCBF3] = CPU::Instruction("set_e_6", 0xCBF3, &CPU::set_e_6, 0);
-	opcode[0xCBF4] = CPU::Instruction("set_h_6", 0xCBF4, &CPU::set_h_6, 0);
-	opcode[0xCBF5] = CPU::Instruction("set_l_6", 0xCBF5, &CPU::set_l_6, 0);
-	opcode[0xCBF6] = CPU::Instruction("set_hl_ref_6", 0xCBF6, &CPU::set_hl_ref_6, 0);
-	opcode[0xCBFF] = CPU::Instruction("set_a_7", 0xCBFF, &CPU::set_a_7, 0);
-	opcode[0xCBF8] = CPU::Instruction("set_b_7", 0xCBF8, &CPU::set_b_7, 0);
-	opcode[0xCBF9] = CPU::Instruction("set_c_7", 0xCBF9, &CPU::set_c_7, 0);
-	opcode[0xCBFA] = CPU::Instruction("set_d_7", 0xCBFA, &CPU::set_d_7, 0);
-	opcode[0xCBFB] = CPU::Instruction("set_e_7", 0xCBFB, &CPU::set_e_7, 0);
-	opcode[0xCBFC] = CPU::Instruction("set_h_7", 0xCBFC, &CPU::set_h_7, 0);
-	opcode[0xCBFD] = CPU::Instruction("set_l_7", 0xCBFD, &CPU::set_l_7, 0);
-	opcode[0xCBFE] = CPU::Instruction("set_hl_ref_7", 0xCBFE, &CPU::set_hl_ref_7, 0);
-	opcode[0xC3] = CPU::Instruction("jp_nn", 0xC3, &CPU::jp_nn, 2);
-	opcode[0xC2] = CPU::Instruction("jp_nz_nn", 0xC2, &CPU::jp_nz_nn, 0);
-	opcode[0xCA] = CPU::Instruction("jp_z_nn", 0xCA, &CPU::jp_z_nn, 0);
-	opcode[0xD2] = CPU::Instruction("jp_nc_nn", 0xD2, &CPU::jp_nc_nn, 0);
-	opcode[0xDA] = CPU::Instruction("jp_c_nn", 0xDA, &CPU::jp_c_nn, 0);
-	opcode[0xE9] = CPU::Instruction("jp_hl", 0xE9, &CPU::jp_hl, 0);
-	opcode[0x18] = CPU::Instruction("jr_n", 0x18, &CPU::jr_n, 1);
-	opcode[0x20] = CPU::Instruction("jr_nz_n", 0x20, &CPU::jr_nz_n, 0);
-	opcode[0x28] = CPU::Instruction("jr_z_n", 0x28, &CPU::jr_z_n, 0);
-	opcode[0x30] = CPU::Instruction("jr_nc_n", 0x30, &CPU::jr_nc_n, 0);
-	opcode[0x38] = CPU::Instruction("jr_c_n", 0x38, &CPU::jr_c_n, 0);
-	opcode[0xCD] = CPU::Instruction("call_nn", 0xCD, &CPU::call_nn, 0);
-	opcode[0xC4] = CPU::Instruction("call_nz_nn", 0xC4, &CPU::call_nz_nn, 0);
-	opcode[0xCC] = CPU::Instruction("call_z_nn", 0xCC, &CPU::call_z_nn, 0);
-	opcode[0xD4] = CPU::Instruction("call_nc_nn", 0xD4, &CPU::call_nc_nn, 0);
-	opcode[0xDC] = CPU::Instruction("call_c_nn", 0xDC, &CPU::call_c_nn, 0);
-	opcode[0xC7] = CPU::Instruction("rst_00", 0xC7, &CPU::rst_00, 0);
-	opcode[0xCF] = CPU::Instruction("rst_08", 0xCF, &CPU::rst_08, 0);
-	opcode[0xD7] = CPU::Instruction("rst_10", 0xD7, &CPU::rst_10, 0);
-	opcode[0xDF] = CPU::Instruction("rst_18", 0xDF, &CPU::rst_18, 0);
-	opcode[0xE7] = CPU::Instruction("rst_20", 0xE7, &CPU::rst_20, 0);
-	opcode[0xEF] = CPU::Instruction("rst_28", 0xEF, &CPU::rst_28, 0);
-	opcode[0xF7] = CPU::Instruction("rst_30", 0xF7, &CPU::rst_30, 0);
-	opcode[0xFF] = CPU::Instruction("rst_38", 0xFF, &CPU::rst_38, 0);
-	opcode[0xC9] = CPU::Instruction("ret", 0xC9, &CPU::ret, 0);
-	opcode[0xC0] = CPU::Instruction("ret_nz", 0xC0, &CPU::ret_nz, 0);
-	opcode[0xC8] = CPU::Instruction("ret_z", 0xC8, &CPU::ret_z, 0);
-	opcode[0xD0] = CPU::Instruction("ret_nc", 0xD0, &CPU::ret_nc, 0);
-	opcode[0xD8] = CPU::Instruction("ret_c", 0xD8, &CPU::ret_c, 0);
-	opcode[0xD9] = CPU::Instruction("reti", 0xD9, &CPU::reti, 0);
-}
\ No newline at end of file
+	Instruction i{};
+	u8 n = 0;
+
+	for (const char *p : parts) {
+		if (n)
+			i.name_[n++] = '_';
+		while (*p)
+			i.name_[n++] = *p++;
+	}
+	i.opcode_ = opcode;
+	i.num_args_ = num_args;
+	return i;
+}
+
+constexpr std::array<Instruction, 256> instructions = [] {
+	std::array<Instruction, 256> t{};
+
+	for (u16 i = 0; i < t.size(); i++)
+		t[i] = op(i, 0, { "nop" });
+
+	for (u8 rr = 0; rr < 4; rr++) {
+		t[0x01 | rr << 4] = op(0x01 | rr << 4, 2, { "ld", r16_names[rr], "nn" });
+		t[0x03 | rr << 4] = op(0x03 | rr << 4, 0, { "inc", r16_names[rr] });
+		t[0x09 | rr << 4] = op(0x09 | rr << 4, 0, { "add_hl", r16_names[rr] });
+		t[0x0B | rr << 4] = op(0x0B | rr << 4, 0, { "dec", r16_names[rr] });
+		t[0xC1 | rr << 4] = op(0xC1 | rr << 4, 0, { "pop", stack_names[rr] });
+		t[0xC5 | rr << 4] = op(0xC5 | rr << 4, 0, { "push", stack_names[rr] });
+	}
+	for (u8 r = 0; r < 8; r++) {
+		t[0x04 | r << 3] = op(0x04 | r << 3, 0, { "inc", r8_names[r] });
+		t[0x05 | r << 3] = op(0x05 | r << 3, 0, { "dec", r8_names[r] });
+		t[0x06 | r << 3] = op(0x06 | r << 3, 1, { "ld", ld_names[r], "n" });
+		t[0xC6 | r << 3] = op(0xC6 | r << 3, 1, { alu_names[r], "a_n" });
+		t[0xC7 | r << 3] = op(0xC7 | r << 3, 0, { "rst", rst_names[r] });
+	}
+	for (u8 i = 0; i < 64; i++) {
+		t[0x40 | i] = op(0x40 | i, 0, { "ld", ld_names[i >> 3], ld_names[i & 7] });
+		t[0x80 | i] = op(0x80 | i, 0, { alu_names[i >> 3], "a", r8_names[i & 7] });
+	}
+	for (u8 cc = 0; cc < 4; cc++) {
+		t[0x20 | cc << 3] = op(0x20 | cc << 3, 1, { "jr", cc_names[cc], "n" });
+		t[0xC0 | cc << 3] = op(0xC0 | cc << 3, 0, { "ret", cc_names[cc] });
+		t[0xC2 | cc << 3] = op(0xC2 | cc << 3, 2, { "jp", cc_names[cc], "nn" });
+		t[0xC4 | cc << 3] = op(0xC4 | cc << 3, 2, { "call", cc_names[cc], "nn" });
+	}
+
+	t[0x02] = op(0x02, 0, { "ld_bc_a" });
+	t[0x07] = op(0x07, 0, { "rlca" });
+	t[0x08] = op(0x08, 2, { "ld_nn_sp" });
+	t[0x0A] = op(0x0A, 0, { "ld_a_bc" });
+	t[0x0F] = op(0x0F, 0, { "rrca" });
+	t[0x10] = op(0x10, 0, { "stop" });
+	t[0x12] = op(0x12, 0, { "ld_de_a" });
+	t[0x17] = op(0x17, 0, { "rla" });
+	t[0x18] = op(0x18, 1, { "jr_n" });
+	t[0x1A] = op(0x1A, 0, { "ld_a_de" });
+	t[0x1F] = op(0x1F, 0, { "rra" });
+	t[0x22] = op(0x22, 0, { "ld_hli_a" });
+	t[0x27] = op(0x27, 0, { "daa" });
+	t[0x2A] = op(0x2A, 0, { "ld_a_hli" });
+	t[0x2F] = op(0x2F, 0, { "cpl" });
+	t[0x32] = op(0x32, 0, { "ld_hld_a" });
+	t[0x37] = op(0x37, 0, { "scf" });
+	t[0x3A] = op(0x3A, 0, { "ld_a_hld" });
+	t[0x3F] = op(0x3F, 0, { "ccf" });
+	t[0x76] = op(0x76, 0, { "halt" });
+	t[0xC3] = op(0xC3, 2, { "jp_nn" });
+	t[0xC9] = op(0xC9, 0, { "ret" });
+	t[0xCB] = op(0xCB, 1, { "prefix_cb" });
+	t[0xCD] = op(0xCD, 2, { "call_nn" });
+	t[0xD9] = op(0xD9, 0, { "reti" });
+	t[0xE0] = op(0xE0, 1, { "ldh_n_a" });
+	t[0xE2] = op(0xE2, 0, { "ldh_c_a" });
+	t[0xE8] = op(0xE8, 1, { "add_sp_n" });
+	t[0xE9] = op(0xE9, 0, { "jp_hl" });
+	t[0xEA] = op(0xEA, 2, { "ld_nn_a" });
+	t[0xF0] = op(0xF0, 1, { "ldh_a_n" });
+	t[0xF2] = op(0xF2, 0, { "ldh_a_c" });
+	t[0xF3] = op(0xF3, 0, { "di" });
+	t[0xF8] = op(0xF8, 1, { "ldhl_sp_n" });
+	t[0xF9] = op(0xF9, 0, { "ld_sp_hl" });
+	t[0xFA] = op(0xFA, 2, { "ld_a_nn" });
+	t[0xFB] = op(0xFB, 0, { "ei" });
+	return t;
+}();
+
+constexpr std::array<Instruction, 256> cb_instructions = [] {
+	std::array<Instruction, 256> t{};
+
+	for (u16 i = 0; i < 64; i++) {
+		const char *r = r8_names[i & 7];
+		const char *b = bit_names[i >> 3];
+
+		t[0x00 | i] = op(0xCB00 | i, 0, { shift_names[i >> 3], r });
+		t[0x40 | i] = op(0xCB40 | i, 0, { "bit", r, b });
+		t[0x80 | i] = op(0xCB80 | i, 0, { "res", r, b });
+		t[0xC0 | i] = op(0xCBC0 | i, 0, { "set", r, b });
+	}
+	return t;
+}();
+
+} // namespace mboy
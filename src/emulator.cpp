@@ -0,0 +1,59 @@
+#include <emulator.hpp>
+#include <bios.hpp>
+
+#include <stdexcept>
+
+namespace mboy
+{
+Emulator::Emulator(const std::string &rom, bool skip_boot)
+{
+	cpu_.attach(&mem_);
+	cpu_.attach(&ppu_);
+	mem_.mount_boot(bios);
+
+	if (!rom.empty()) {
+		cart_ = std::make_unique<Cartridge>(rom);
+		cart_->attach(&mem_);
+	}
+	if (skip_boot)
+		cpu_.skip_boot();
+}
+
+Emulator::Emulator(Emulator &other, Memory::Branch b)
+	: mem_(other.mem_, b), cpu_(other.cpu_), ppu_(other.ppu_),
+	  cart_(other.cart_ ? other.cart_->branch() : nullptr)
+{
+	// the copies still point at the parts of other
+	cpu_.attach(&mem_);
+	cpu_.attach(&ppu_);
+	ppu_.publish_to(nullptr);
+	if (cart_)
+		cart_->attach(&mem_);
+}
+
+std::unique_ptr<Emulator> Emulator::branch()
+{
+	return std::unique_ptr<Emulator>(new Emulator(*this, Memory::Branch{}));
+}
+
+void Emulator::save(State &s, u32 since)
+{
+	cpu_.save(s, since);
+	ppu_.save(s);
+	if (cart_)
+		cart_->save(s);
+}
+
+void Emulator::load(const State &s)
+{
+	// reject it before anything changes
+	if (s.header.cart_ram_size != (cart_ ? cart_->ram_size() : 0))
+		throw std::runtime_error("save state: cartridge RAM size does not match");
+
+	cpu_.load(s);
+	ppu_.load(s);
+	if (cart_)
+		cart_->load(s);
+}
+
+} // namespace mboy
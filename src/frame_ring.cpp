@@ -0,0 +1,127 @@
+#include <frame_ring.hpp>
+#include <ppu.hpp>
+
+#include <algorithm>
+#include <bit>
+#include <cstring>
+#include <fcntl.h>
+#include <stdexcept>
+#include <sys/mman.h>
+#include <unistd.h>
+
+namespace mboy
+{
+FrameRing::FrameRing(const std::string &name, Format format, u32 slots)
+	: format_(format), slots_(std::max(slots, 1u))
+{
+	static constexpr u32 bits[] = {2, 8, 32};
+	std::string what = name.empty() ? "frame ring" : name;
+
+	stride_ = PPU::width * bits[format] / 8;
+	slot_size_ = (sizeof(Slot) + stride_ * PPU::height + 63) / 64 * 64;
+	size_ = sizeof(Header) + slots_ * slot_size_;
+
+	if (name.empty())
+		fd_ = memfd_create("myboy-frames", 0);
+	else
+		fd_ = shm_open((name[0] == '/' ? name : "/" + name).c_str(), O_RDWR | O_CREAT, 0644);
+	if (fd_ < 0)
+		throw std::runtime_error(what + ": cannot create");
+
+	if (ftruncate(fd_, size_) < 0) {
+		close(fd_);
+		throw std::runtime_error(what + ": cannot resize");
+	}
+	void *p = mmap(nullptr, size_, PROT_READ | PROT_WRITE, MAP_SHARED, fd_, 0);
+	if (p == MAP_FAILED) {
+		close(fd_);
+		throw std::runtime_error(what + ": cannot map");
+	}
+	base_ = static_cast<u8 *>(p);
+
+	// an existing ring starts over, every slot empty
+	std::memset(base_, 0, size_);
+	Header &h = header();
+	h.version = version;
+	h.format = format_;
+	h.width = PPU::width;
+	h.height = PPU::height;
+	h.stride = stride_;
+	h.slots = slots_;
+	h.slot_size = slot_size_;
+	std::atomic_thread_fence(std::memory_order_release);
+	std::memcpy(h.magic, "MBOYRING", sizeof(h.magic));
+}
+
+FrameRing::~FrameRing()
+{
+	munmap(base_, size_);
+	close(fd_);
+}
+
+FrameRing::Format FrameRing::format(const std::string &name)
+{
+	if (name == "indexed")
+		return indexed;
+	if (name == "grey")
+		return grey;
+	if (name == "rgba")
+		return rgba;
+	throw std::runtime_error("unknown frame format " + name);
+}
+
+void FrameRing::publish(const u8 *frame, u64 frame_no, u64 cycles)
+{
+	u64 n = ++published_;
+	Slot &s = *reinterpret_cast<Slot *>(base_ + sizeof(Header) + (n - 1) % slots_ * slot_size_);
+
+	// odd before any pixel changes, 2n once all of them did
+	s.seq.store(2 * n - 1, std::memory_order_relaxed);
+	std::atomic_thread_fence(std::memory_order_release);
+	s.frame = frame_no;
+	s.cycles = cycles;
+	convert(frame, reinterpret_cast<u8 *>(&s + 1));
+	s.seq.store(2 * n, std::memory_order_release);
+
+	header().published.store(n, std::memory_order_release);
+}
+
+static_assert(PPU::width % 8 == 0, "lines are converted 8 pixels at a time at most");
+
+/* A word at a time: shades are at most 3, so no multiplication carries
+ * from one pixel into the next
+ */
+void FrameRing::convert(const u8 *frame, u8 *out) const
+{
+	static constexpr size_t n = PPU::width * PPU::height;
+	// R, G and B of 0x55 and A of 0xFF in memory order
+	static constexpr u32 rgb = std::endian::native == std::endian::little ? 0x00555555 : 0x55555500;
+	static constexpr u32 alpha = std::endian::native == std::endian::little ? 0xFF000000 : 0x000000FF;
+
+	switch (format_) {
+	case indexed:
+		// moves pixel i of x to bits 31 - 2 * i and 30 - 2 * i, the other
+		// products stay below bit 24 or overflow
+		for (size_t i = 0; i < n / 4; i++, frame += 4) {
+			u32 x = frame[0] | frame[1] << 8 | frame[2] << 16 | frame[3] << 24;
+			out[i] = x * 0x40100401 >> 24;
+		}
+		break;
+	case grey:
+		for (size_t i = 0; i < n; i += 8) {
+			u64 x;
+			std::memcpy(&x, frame + i, 8);
+			x = (0x0303030303030303 - x) * 0x55;
+			std::memcpy(out + i, &x, 8);
+		}
+		break;
+	case rgba:
+		for (size_t i = 0; i < n; i++) {
+			u32 x = (3 - frame[i]) * rgb | alpha;
+			std::memcpy(out + 4 * i, &x, 4);
+		}
+		break;
+	}
+}
+
+} // namespace mboy
@@ -0,0 +1,423 @@
+#include <jit.hpp>
+#include <memory.hpp>
+
+#include <cstring>
+#include <sys/mman.h>
+
+namespace mboy
+{
+/* Host registers, numbered as in the ModRM byte */
+enum : u8 { ax = 0, cx = 1, dx = 2, bx = 3, si = 6 };
+
+/* SM83 8-bit register (B, C, D, E, H, L, -, A) to host byte register */
+static constexpr u8 host_r8[8] = {
+	7, // B = bh
+	3, // C = bl
+	5, // D = ch
+	1, // E = cl
+	6, // H = dh
+	2, // L = dl
+	0xFF, // (HL)
+	4, // A = ah
+};
+
+/* SM83 16-bit register (BC, DE, HL, SP) to host word register */
+static constexpr u8 host_r16[4] = {bx, cx, dx, si};
+
+Jit::Jit()
+{
+	void *p = mmap(nullptr, arena_size, PROT_READ | PROT_WRITE | PROT_EXEC, MAP_PRIVATE | MAP_ANONYMOUS,
+		       -1, 0);
+	// without executable memory everything is left to the interpreter
+	if (p != MAP_FAILED)
+		arena_ = static_cast<u8 *>(p);
+}
+
+Jit::~Jit()
+{
+	if (arena_)
+		munmap(arena_, arena_size);
+}
+
+bool Jit::run(CPU &cpu, CPU::Block &b, u16 addr, u64 end)
+{
+	if (!arena_)
+		return false;
+
+	if (cpu.mem->code_gen() != code_gen_) {
+		code_gen_ = cpu.mem->code_gen();
+		unlink();
+	}
+
+	if (!b.native_) {
+		if (++b.hits_ < hot_threshold)
+			return false;
+		b.native_ = compile(cpu, b, addr);
+	}
+
+	if (cpu.cycles + b.max_cycles_ > end)
+		return false;
+
+	if (b.epoch_ != epoch_) {
+		link(addr, b.body_);
+		b.epoch_ = epoch_;
+	}
+
+	reinterpret_cast<native_fn>(b.native_)(&cpu, end);
+	return true;
+}
+
+/****************
+ * Translation  *
+ ****************/
+
+/* PC values a block can end with, empty if it is only known at runtime */
+static std::vector<u16> successors(u8 op, const u8 *imm, u16 next)
+{
+	u16 nn = imm[0] | imm[1] << 8;
+	u16 rel = next + static_cast<i8>(imm[0]);
+
+	switch (op) {
+	case 0x18: // JR
+		return {rel};
+	case 0x20: case 0x28: case 0x30: case 0x38: // JR cc
+		return rel == next ? std::vector<u16>{next} : std::vector<u16>{rel, next};
+	case 0xC3: case 0xCD: // JP, CALL
+		return {nn};
+	case 0xC2: case 0xCA: case 0xD2: case 0xDA: // JP cc
+	case 0xC4: case 0xCC: case 0xD4: case 0xDC: // CALL cc
+		return nn == next ? std::vector<u16>{next} : std::vector<u16>{nn, next};
+	case 0x10: case 0x76: case 0xE9: // STOP, HALT, JP (HL)
+	case 0xC0: case 0xC8: case 0xC9: case 0xD0: case 0xD8: case 0xD9: // RET
+		return {};
+	default:
+		if ((op & 0xC7) == 0xC7) // RST
+			return {static_cast<u16>(op & 0x38)};
+		return {next}; // the block reached max_block_len
+	}
+}
+
+u8 *Jit::compile(CPU &cpu, CPU::Block &b, u16 addr)
+{
+	if (arena_size - used_ < max_code_len)
+		flush(cpu);
+
+	auto offset = [](const void *base, const void *field) {
+		return static_cast<i32>(static_cast<const u8 *>(field) - static_cast<const u8 *>(base));
+	};
+	off_ = {
+		offset(&cpu, &cpu.AF),
+		offset(&cpu, &cpu.BC),
+		offset(&cpu, &cpu.DE),
+		offset(&cpu, &cpu.HL),
+		offset(&cpu, &cpu.SP),
+		offset(&cpu, &cpu.PC),
+		offset(&cpu, &cpu.cycles),
+		offset(&cpu, &cpu.imm_),
+		offset(&cpu, &cpu.mem),
+		offset(cpu.mem, &cpu.mem->code_gen_),
+		offset(&cpu, &cpu.sched.next_),
+	};
+
+	u8 *entry = code_ = arena_ + used_;
+	in_regs_ = false;
+	pending_ = 0;
+	exits_.clear();
+
+	// native_fn(CPU *cpu = rdi, u64 end = rsi)
+	emit({0x53, 0x55, 0x41, 0x54, 0x41, 0x55}); // push rbx, rbp, r12, r13
+	emit({0x48, 0x83, 0xEC, 0x08}); // sub rsp, 8
+	emit({0x48, 0x89, 0xFD}); // mov rbp, rdi
+	emit({0x49, 0x89, 0xF5}); // mov r13, rsi
+	emit({0x48, 0x8B, 0x85}); // mov rax, [rbp + mem]
+	emit32(off_.mem);
+	emit({0x44, 0x8B, 0xA0}); // mov r12d, [rax + code_gen_]
+	emit32(off_.code_gen);
+	b.body_ = code_;
+
+	u16 pc = addr;
+	u8 op = 0;
+	bool native_last = false;
+	u32 left = b.max_cycles_;
+	for (const CPU::DecodedOp &d : b.ops_) {
+		op = cpu.mem->read(pc);
+		left -= d.cycles_;
+		native_last = d.opcode_len_ == 1 && native(op, d);
+		if (!native_last)
+			call(d, pc, left);
+		pc += d.len_;
+	}
+
+	const CPU::DecodedOp &last = b.ops_.back();
+	std::vector<u16> next = successors(op, last.imm_, pc);
+
+	if (in_regs_)
+		spill();
+	add_cycles(pending_);
+	if (native_last)
+		store_pc(next.front());
+
+	std::vector<std::pair<u8 *, u16>> slots;
+	if (!next.empty()) {
+		emit({0x48, 0x8B, 0x85}); // mov rax, [rbp + cycles]
+		emit32(off_.cycles);
+		emit({0x48, 0x05}); // add rax, max_block_cycles
+		emit32(max_block_cycles);
+		emit({0x4C, 0x39, 0xE8}); // cmp rax, r13
+		exits_.push_back(emit_jump({0x0F, 0x87})); // ja epilogue
+		emit({0x48, 0x3B, 0x85}); // cmp rax, [rbp + next_event]
+		emit32(off_.next_event);
+		exits_.push_back(emit_jump({0x0F, 0x87})); // ja epilogue
+
+		if (native_last) {
+			slots.push_back({emit_jump({0xE9}), next.front()});
+		} else {
+			emit({0x0F, 0xB7, 0x85}); // movzx eax, word [rbp + PC]
+			emit32(off_.PC);
+			for (u16 t : next) {
+				emit({0x3D}); // cmp eax, t
+				emit32(t);
+				emit({0x75, 0x05}); // jne over the slot
+				slots.push_back({emit_jump({0xE9}), t});
+			}
+		}
+	}
+
+	u8 *epilogue = code_;
+	emit({0x48, 0x83, 0xC4, 0x08}); // add rsp, 8
+	emit({0x41, 0x5D, 0x41, 0x5C, 0x5D, 0x5B}); // pop r13, r12, rbp, rbx
+	emit({0xC3}); // ret
+
+	for (u8 *rel : exits_)
+		patch(rel, epilogue);
+
+	for (auto [rel, target] : slots) {
+		targets_[target].push_back(slots_.size());
+		slots_.push_back({rel, epilogue});
+		auto it = entries_.find(target);
+		patch(rel, it != entries_.end() ? it->second : epilogue);
+	}
+
+	used_ = code_ - arena_;
+	return entry;
+}
+
+/* Translate an instruction without memory accesses or flags, returns false
+ * if it has to call its handler
+ */
+bool Jit::native(u8 op, const CPU::DecodedOp &d)
+{
+	u8 dst = op >> 3 & 7;
+	u8 src = op & 7;
+	u8 rr = op >> 4 & 3;
+
+	if (op == 0x00 || op == 0x18 || op == 0xC3) {
+		// NOP, and JR and JP, which end the block with a constant PC
+		pending_ += d.cycles_;
+		return true;
+	}
+
+	bool ld_r_r = op >= 0x40 && op < 0x80 && dst != 6 && src != 6;
+	bool ld_r_n = (op & 0xC7) == 0x06 && dst != 6;
+	bool ld_rr_nn = (op & 0xCF) == 0x01;
+	bool inc_rr = (op & 0xCF) == 0x03;
+	bool dec_rr = (op & 0xCF) == 0x0B;
+	bool ld_sp_hl = op == 0xF9;
+	if (!(ld_r_r || ld_r_n || ld_rr_nn || inc_rr || dec_rr || ld_sp_hl))
+		return false;
+
+	if (!in_regs_)
+		reload();
+
+	if (ld_r_r && dst != src) {
+		emit({0x88, static_cast<u8>(0xC0 | host_r8[src] << 3 | host_r8[dst])}); // mov dst, src
+	} else if (ld_r_n) {
+		emit({static_cast<u8>(0xB0 + host_r8[dst]), d.imm_[0]}); // mov dst, n
+	} else if (ld_rr_nn) {
+		emit({0x66, static_cast<u8>(0xB8 + host_r16[rr])}); // mov rr, nn
+		emit16(d.imm_[0] | d.imm_[1] << 8);
+	} else if (inc_rr) {
+		emit({0x66, 0xFF, static_cast<u8>(0xC0 + host_r16[rr])}); // inc rr
+	} else if (dec_rr) {
+		emit({0x66, 0xFF, static_cast<u8>(0xC8 + host_r16[rr])}); // dec rr
+	} else if (ld_sp_hl) {
+		emit({0x66, 0x89, static_cast<u8>(0xC0 | dx << 3 | si)}); // mov si, dx
+	}
+
+	pending_ += d.cycles_;
+	return true;
+}
+
+/* Call the handler of an instruction the way CPU::run() does. left is the
+ * most the rest of the block can take.
+ */
+void Jit::call(const CPU::DecodedOp &d, u16 pc, u32 left)
+{
+	if (in_regs_)
+		spill();
+
+	const CPU::DecodedOp &op = ops_.emplace_back(d);
+
+	store_pc(pc + d.opcode_len_);
+	emit({0x48, 0xB8}); // mov rax, op.imm_
+	emit64(reinterpret_cast<u64>(op.imm_));
+	emit({0x48, 0x89, 0x85}); // mov [rbp + imm_], rax
+	emit32(off_.imm);
+	add_cycles(pending_ + d.cycles_);
+	pending_ = 0;
+
+	emit({0x48, 0x89, 0xEF}); // mov rdi, rbp
+	/* The Itanium C++ ABI represents a pointer to a non-virtual member
+	 * function as the function's address and an adjustment of this, which is
+	 * 0 for CPU.
+	 */
+	struct {
+		u64 ptr;
+		u64 adj;
+	} handler;
+	static_assert(sizeof(handler) == sizeof(d.func_));
+	std::memcpy(&handler, &d.func_, sizeof(handler));
+
+	emit({0x48, 0xB8}); // mov rax, handler
+	emit64(handler.ptr);
+	emit({0xFF, 0xD0}); // call rax
+
+	// leave if the instruction wrote code or made an event due before the
+	// block ends, such as EI does: native instructions do not check for
+	// events, CPU::run_for() runs the rest one by one
+	emit({0x48, 0x8B, 0x85}); // mov rax, [rbp + mem]
+	emit32(off_.mem);
+	emit({0x44, 0x3B, 0xA0}); // cmp r12d, [rax + code_gen_]
+	emit32(off_.code_gen);
+	exits_.push_back(emit_jump({0x0F, 0x85})); // jne epilogue
+	emit({0x48, 0x8B, 0x85}); // mov rax, [rbp + cycles]
+	emit32(off_.cycles);
+	emit({0x48, 0x05}); // add rax, left
+	emit32(left);
+	emit({0x48, 0x3B, 0x85}); // cmp rax, [rbp + next_event]
+	emit32(off_.next_event);
+	exits_.push_back(emit_jump({0x0F, 0x87})); // ja epilogue
+}
+
+/*************************
+ * Linking and Flushing  *
+ *************************/
+
+void Jit::link(u16 addr, u8 *entry)
+{
+	entries_[addr] = entry;
+
+	auto it = targets_.find(addr);
+	if (it == targets_.end())
+		return;
+	for (size_t i : it->second)
+		patch(slots_[i].rel_, entry);
+}
+
+void Jit::unlink()
+{
+	for (const Slot &s : slots_)
+		patch(s.rel_, s.exit_);
+	entries_.clear();
+	epoch_++;
+}
+
+/* Drop all compiled code once the arena is full */
+void Jit::flush(CPU &cpu)
+{
+	for (auto &[addr, b] : cpu.cache_.blocks_) {
+		b.hits_ = 0;
+		b.epoch_ = 0;
+		b.native_ = nullptr;
+		b.body_ = nullptr;
+	}
+	ops_.clear();
+	slots_.clear();
+	targets_.clear();
+	entries_.clear();
+	used_ = 0;
+	epoch_++;
+}
+
+void Jit::patch(u8 *rel, u8 *target)
+{
+	i32 v = static_cast<i32>(target - (rel + 4));
+	std::memcpy(rel, &v, 4);
+}
+
+/*************
+ * Emitters  *
+ *************/
+
+void Jit::emit(std::initializer_list<u8> bytes)
+{
+	for (u8 b : bytes)
+		*code_++ = b;
+}
+
+void Jit::emit16(u16 v)
+{
+	std::memcpy(code_, &v, 2);
+	code_ += 2;
+}
+
+void Jit::emit32(u32 v)
+{
+	std::memcpy(code_, &v, 4);
+	code_ += 4;
+}
+
+void Jit::emit64(u64 v)
+{
+	std::memcpy(code_, &v, 8);
+	code_ += 8;
+}
+
+/* Emit a jump with a rel32 operand, returns the operand for patch() */
+u8 *Jit::emit_jump(std::initializer_list<u8> opcode)
+{
+	emit(opcode);
+	u8 *rel = code_;
+	emit32(0);
+	return rel;
+}
+
+/* Store the host registers to the CPU */
+void Jit::spill()
+{
+	const std::pair<u8, i32> regs[] = {{ax, off_.AF}, {bx, off_.BC}, {cx, off_.DE}, {dx, off_.HL}, {si, off_.SP}};
+	for (auto [r, off] : regs) {
+		emit({0x66, 0x89, static_cast<u8>(0x85 | r << 3)}); // mov [rbp + off], r
+		emit32(off);
+	}
+	in_regs_ = false;
+}
+
+/* Load the host registers from the CPU */
+void Jit::reload()
+{
+	const std::pair<u8, i32> regs[] = {{ax, off_.AF}, {bx, off_.BC}, {cx, off_.DE}, {dx, off_.HL}, {si, off_.SP}};
+	for (auto [r, off] : regs) {
+		emit({0x66, 0x8B, static_cast<u8>(0x85 | r << 3)}); // mov r, [rbp + off]
+		emit32(off);
+	}
+	in_regs_ = true;
+}
+
+void Jit::add_cycles(u32 n)
+{
+	if (!n)
+		return;
+	emit({0x48, 0x81, 0x85}); // add qword [rbp + cycles], n
+	emit32(off_.cycles);
+	emit32(n);
+}
+
+void Jit::store_pc(u16 pc)
+{
+	emit({0x66, 0xC7, 0x85}); // mov word [rbp + PC], pc
+	emit32(off_.PC);
+	emit16(pc);
+}
+
+} // namespace mboy
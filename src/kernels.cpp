@@ -0,0 +1,172 @@
+#include <kernels.hpp>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define MBOY_X86_KERNELS
+#endif
+
+namespace mboy
+{
+/**********
+ * Scalar *
+ **********/
+
+static void decode_scalar(const u8 *rows, u8 *px, size_t n)
+{
+	for (size_t r = 0; r < n; r++, rows += 2, px += 8) {
+		for (int i = 0; i < 8; i++)
+			px[i] = (rows[0] >> (7 - i) & 1) | (rows[1] >> (7 - i) & 1) << 1;
+	}
+}
+
+static void map_scalar(const u8 *px, u8 *out, u8 palette, size_t n)
+{
+	for (size_t i = 0; i < n; i++)
+		out[i] = palette >> 2 * px[i] & 3;
+}
+
+const PixelKernels PixelKernels::scalar = {"scalar", decode_scalar, map_scalar};
+
+#ifdef MBOY_X86_KERNELS
+
+/********
+ * SSE2 *
+ ********/
+
+/* The low byte of a row 8 times, then the high byte 8 times, into its bits
+ * weighted by plane
+ */
+__attribute__((target("sse2"))) static inline __m128i planes(__m128i row)
+{
+	const __m128i bits = _mm_set_epi8(1, 2, 4, 8, 16, 32, 64, -128, 1, 2, 4, 8, 16, 32, 64, -128);
+	const __m128i weight = _mm_set_epi8(2, 2, 2, 2, 2, 2, 2, 2, 1, 1, 1, 1, 1, 1, 1, 1);
+
+	return _mm_and_si128(_mm_cmpeq_epi8(_mm_and_si128(row, bits), bits), weight);
+}
+
+/* The planes of two rows into their 16 pixels */
+__attribute__((target("sse2"))) static inline __m128i merge(__m128i a, __m128i b)
+{
+	a = planes(a);
+	b = planes(b);
+	return _mm_add_epi8(_mm_unpacklo_epi64(a, b), _mm_unpackhi_epi64(a, b));
+}
+
+/* Eight rows at a time: unpacking the rows with themselves three times
+ * spreads each byte over the 8 pixels it has a bit of
+ */
+__attribute__((target("sse2"))) static void decode_sse2(const u8 *rows, u8 *px, size_t n)
+{
+	size_t r = 0;
+
+	for (; r + 8 <= n; r += 8, rows += 16, px += 64) {
+		__m128i in = _mm_loadu_si128(reinterpret_cast<const __m128i *>(rows));
+
+		for (int half = 0; half < 2; half++) {
+			__m128i a = half ? _mm_unpackhi_epi8(in, in) : _mm_unpacklo_epi8(in, in);
+			__m128i b0 = _mm_unpacklo_epi16(a, a);
+			__m128i b1 = _mm_unpackhi_epi16(a, a);
+			__m128i *out = reinterpret_cast<__m128i *>(px + 32 * half);
+
+			_mm_storeu_si128(out, merge(_mm_unpacklo_epi32(b0, b0), _mm_unpackhi_epi32(b0, b0)));
+			_mm_storeu_si128(out + 1, merge(_mm_unpacklo_epi32(b1, b1), _mm_unpackhi_epi32(b1, b1)));
+		}
+	}
+	decode_scalar(rows, px, n - r);
+}
+
+/* Without a byte shuffle: select each of the four shades where it applies */
+__attribute__((target("sse2"))) static void map_sse2(const u8 *px, u8 *out, u8 palette, size_t n)
+{
+	__m128i shade[4];
+	for (int c = 0; c < 4; c++)
+		shade[c] = _mm_set1_epi8(static_cast<char>(palette >> 2 * c & 3));
+	size_t i = 0;
+
+	for (; i + 16 <= n; i += 16) {
+		__m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i *>(px + i));
+		__m128i res = _mm_setzero_si128();
+
+		for (int c = 1; c < 4; c++)
+			res = _mm_or_si128(res, _mm_and_si128(_mm_cmpeq_epi8(v, _mm_set1_epi8(c)), shade[c]));
+		res = _mm_or_si128(res, _mm_and_si128(_mm_cmpeq_epi8(v, _mm_setzero_si128()), shade[0]));
+		_mm_storeu_si128(reinterpret_cast<__m128i *>(out + i), res);
+	}
+	map_scalar(px + i, out + i, palette, n - i);
+}
+
+static const PixelKernels sse2 = {"sse2", decode_sse2, map_sse2};
+
+/********
+ * AVX2 *
+ ********/
+
+/* Eight rows, four per vector: a shuffle spreads the low and the high byte
+ * of each row over its 8 pixels, the pixel's bit is picked as with SSE2
+ */
+__attribute__((target("avx2"))) static void decode_avx2(const u8 *rows, u8 *px, size_t n)
+{
+	const __m256i bits = _mm256_set1_epi64x(0x0102040810204080);
+	// rows 0, 1 in the low lane, 2, 3 in the high one, 4 - 7 likewise
+	const __m256i lo[2] = {
+		_mm256_setr_epi8(0, 0, 0, 0, 0, 0, 0, 0, 2, 2, 2, 2, 2, 2, 2, 2,
+				 4, 4, 4, 4, 4, 4, 4, 4, 6, 6, 6, 6, 6, 6, 6, 6),
+		_mm256_setr_epi8(8, 8, 8, 8, 8, 8, 8, 8, 10, 10, 10, 10, 10, 10, 10, 10,
+				 12, 12, 12, 12, 12, 12, 12, 12, 14, 14, 14, 14, 14, 14, 14, 14),
+	};
+	const __m256i one = _mm256_set1_epi8(1);
+	size_t r = 0;
+
+	for (; r + 8 <= n; r += 8, rows += 16, px += 64) {
+		__m256i in = _mm256_broadcastsi128_si256(_mm_loadu_si128(reinterpret_cast<const __m128i *>(rows)));
+
+		for (int half = 0; half < 2; half++) {
+			__m256i l = _mm256_shuffle_epi8(in, lo[half]);
+			__m256i h = _mm256_shuffle_epi8(in, _mm256_add_epi8(lo[half], one));
+			__m256i pl = _mm256_and_si256(_mm256_cmpeq_epi8(_mm256_and_si256(l, bits), bits), one);
+			__m256i ph = _mm256_and_si256(_mm256_cmpeq_epi8(_mm256_and_si256(h, bits), bits), _mm256_add_epi8(one, one));
+
+			_mm256_storeu_si256(reinterpret_cast<__m256i *>(px + 32 * half), _mm256_or_si256(pl, ph));
+		}
+	}
+	// the tail may be SSE code, which stalls on the upper halves
+	_mm256_zeroupper();
+	decode_scalar(rows, px, n - r);
+}
+
+/* The four shades are a table for a byte shuffle, indexed by colour number.
+ * Only its first four bytes are looked up, so it is one broadcast.
+ */
+__attribute__((target("avx2"))) static void map_avx2(const u8 *px, u8 *out, u8 palette, size_t n)
+{
+	const __m256i table = _mm256_set1_epi32((palette & 3) | (palette >> 2 & 3) << 8 | (palette >> 4 & 3) << 16 |
+						(palette >> 6) << 24);
+	size_t i = 0;
+
+	for (; i + 32 <= n; i += 32) {
+		__m256i v = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(px + i));
+		_mm256_storeu_si256(reinterpret_cast<__m256i *>(out + i), _mm256_shuffle_epi8(table, v));
+	}
+	map_scalar(px + i, out + i, palette, n - i);
+}
+
+static const PixelKernels avx2 = {"avx2", decode_avx2, map_avx2};
+
+#endif
+
+const PixelKernels &PixelKernels::best()
+{
+	static const PixelKernels &k = [] () -> const PixelKernels & {
+#ifdef MBOY_X86_KERNELS
+		__builtin_cpu_init();
+		if (__builtin_cpu_supports("avx2"))
+			return avx2;
+		if (__builtin_cpu_supports("sse2"))
+			return sse2;
+#endif
+		return scalar;
+	}();
+	return k;
+}
+
+} // namespace mboy
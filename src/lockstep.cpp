@@ -0,0 +1,673 @@
+#include <lockstep.hpp>
+#include <instruction.hpp>
+
+#include <algorithm>
+
+namespace mboy
+{
+static constexpr u8 flag_z = 0x80;
+static constexpr u8 flag_n = 0x40;
+static constexpr u8 flag_h = 0x20;
+static constexpr u8 flag_c = 0x10;
+
+Lockstep::Lockstep(const std::string &rom, size_t lanes, bool skip_boot)
+{
+	lanes = std::max<size_t>(lanes, 1);
+	for (size_t i = 0; i < lanes; i++)
+		lanes_.push_back(std::make_unique<Emulator>(rom, skip_boot));
+
+	groups_.resize((lanes + width - 1) / width);
+	val_.resize(groups_.size());
+	gens_.resize(lanes);
+	code_gen_.resize(lanes);
+}
+
+void Lockstep::run_for(u64 n)
+{
+	std::vector<u64> end;
+	for (std::unique_ptr<Emulator> &e : lanes_)
+		end.push_back(e->cpu().cycles + n);
+
+	while (gather()) {
+		while (cycles_ < end[0] && cycles_ < next_ && step())
+			shared_++;
+		scatter();
+		if (cycles_ >= end[0])
+			return;
+		step_alone(end);
+	}
+
+	// apart, until they meet again in a later call
+	for (size_t i = 0; i < lanes_.size(); i++) {
+		CPU &cpu = lanes_[i]->cpu();
+		if (cpu.cycles < end[i])
+			cpu.run_for(end[i] - cpu.cycles);
+	}
+}
+
+/* Take the registers of the lanes, if they are all at the same place */
+bool Lockstep::gather()
+{
+	const CPU &first = lanes_[0]->cpu();
+
+	for (std::unique_ptr<Emulator> &e : lanes_) {
+		const CPU &cpu = e->cpu();
+		if (cpu.PC != first.PC || cpu.cycles != first.cycles || cpu.halted())
+			return false;
+	}
+
+	for (size_t i = 0; i < lanes_.size(); i++) {
+		CPU &cpu = lanes_[i]->cpu();
+		Group &g = groups_[i / width];
+		size_t j = i % width;
+
+		cpu.sync_flags();
+		g.r[0][j] = cpu.B;
+		g.r[1][j] = cpu.C;
+		g.r[2][j] = cpu.D;
+		g.r[3][j] = cpu.E;
+		g.r[4][j] = cpu.H;
+		g.r[5][j] = cpu.L;
+		g.r[rF][j] = cpu.F;
+		g.r[rA][j] = cpu.A;
+		g.SP[j] = cpu.SP;
+	}
+	PC_ = first.PC;
+	cycles_ = first.cycles;
+	accessed();
+	return true;
+}
+
+/* Hand the registers back to the lanes */
+void Lockstep::scatter()
+{
+	for (size_t i = 0; i < lanes_.size(); i++) {
+		CPU &cpu = lanes_[i]->cpu();
+		const Group &g = groups_[i / width];
+		size_t j = i % width;
+
+		cpu.B = g.r[0][j];
+		cpu.C = g.r[1][j];
+		cpu.D = g.r[2][j];
+		cpu.E = g.r[3][j];
+		cpu.H = g.r[4][j];
+		cpu.L = g.r[5][j];
+		cpu.F = g.r[rF][j];
+		cpu.A = g.r[rA][j];
+		cpu.SP = g.SP[j];
+		cpu.PC = PC_;
+		cpu.cycles = cycles_;
+	}
+}
+
+/* One instruction on every lane's own CPU, the way CPU::run_for() would */
+void Lockstep::step_alone(const std::vector<u64> &end)
+{
+	for (size_t i = 0; i < lanes_.size(); i++) {
+		CPU &cpu = lanes_[i]->cpu();
+
+		if (cpu.cycles >= end[i])
+			continue;
+		if (cpu.halted() && cpu.cycles < cpu.sched.next())
+			cpu.cycles = std::min(end[i], cpu.sched.next());
+		else
+			cpu.run_for(1);
+		alone_++;
+	}
+}
+
+/*************
+ * Lane Code *
+ *************/
+
+/* Whether every lane has the same bytes at addr .. addr + len - 1.
+ * Pages are compared once and watched like decoded code, so that a write or
+ * a bank switch has them compared again.
+ */
+bool Lockstep::same_code(u16 addr, u8 len)
+{
+	for (u8 page : {static_cast<u8>(addr >> 8), static_cast<u8>((addr + len - 1) >> 8)}) {
+		// reading the IO registers may change them
+		if (page == 0xFF || apart_[page])
+			return false;
+		if (same_[page])
+			continue;
+
+		for (size_t i = 0; i < lanes_.size(); i++) {
+			Memory &mem = lanes_[i]->mem();
+			mem.watch_code(page << 8);
+			gens_[i][page] = mem.page_gen(page << 8);
+		}
+
+		const Memory &first = lanes_[0]->mem();
+		for (size_t i = 1; i < lanes_.size() && !apart_[page]; i++) {
+			const Memory &mem = lanes_[i]->mem();
+			for (unsigned k = 0; k < 256; k++) {
+				if (mem.read(page << 8 | k) != first.read(page << 8 | k)) {
+					apart_[page] = true;
+					break;
+				}
+			}
+		}
+		if (apart_[page])
+			return false;
+		same_[page] = true;
+	}
+	return true;
+}
+
+/* After the lanes went to their buses: events may have been scheduled and
+ * code may have been written or banked out.
+ */
+void Lockstep::accessed()
+{
+	next_ = Scheduler::never;
+
+	for (size_t i = 0; i < lanes_.size(); i++) {
+		const Memory &mem = lanes_[i]->mem();
+
+		next_ = std::min(next_, lanes_[i]->cpu().sched.next());
+		if (mem.code_gen() == code_gen_[i])
+			continue;
+
+		code_gen_[i] = mem.code_gen();
+		for (unsigned page = 0; page < 256; page++) {
+			if ((same_[page] || apart_[page]) && mem.page_gen(page << 8) != gens_[i][page]) {
+				same_[page] = false;
+				apart_[page] = false;
+			}
+		}
+	}
+}
+
+/*****************
+ * Lane Accesses *
+ *****************/
+
+/* The bus of a lane, which sees the time of the instruction running */
+Memory &Lockstep::bus(size_t lane)
+{
+	lanes_[lane]->cpu().cycles = cycles_;
+	return lanes_[lane]->mem();
+}
+
+bool Lockstep::cond(u8 cc, size_t lane)
+{
+	u8 f = get(lane, rF);
+
+	switch (cc) {
+	case 0:
+		return !(f & flag_z);
+	case 1:
+		return f & flag_z;
+	case 2:
+		return !(f & flag_c);
+	default:
+		return f & flag_c;
+	}
+}
+
+/* 1 if f(lane) holds for every lane, 0 if for none, -1 otherwise */
+template <typename F> int Lockstep::uniform(F f)
+{
+	bool first = f(0);
+
+	for (size_t i = 1; i < lanes_.size(); i++)
+		if (f(i) != first)
+			return -1;
+	return first;
+}
+
+void Lockstep::load(u8 r, u8 hi)
+{
+	for (size_t i = 0; i < lanes_.size(); i++)
+		set(i, r, bus(i).read(pair(i, hi)));
+	accessed();
+}
+
+void Lockstep::store(u8 hi, u8 r)
+{
+	for (size_t i = 0; i < lanes_.size(); i++)
+		bus(i).write(pair(i, hi), get(i, r));
+	accessed();
+}
+
+void Lockstep::inc16(u8 hi, bool down)
+{
+	for (Group &g : groups_) {
+		if (hi == 6 && down) {
+			g.SP -= 1;
+		} else if (hi == 6) {
+			g.SP += 1;
+		} else if (down) {
+			g.r[hi + 1] -= 1;
+			g.r[hi] += (Vec)(g.r[hi + 1] == 0xFF); // borrow is -1
+		} else {
+			g.r[hi + 1] += 1;
+			g.r[hi] -= (Vec)(g.r[hi + 1] == 0); // carry is -1
+		}
+	}
+}
+
+void Lockstep::push(u16 val)
+{
+	for (size_t i = 0; i < lanes_.size(); i++) {
+		Group &g = groups_[i / width];
+		u16 sp = g.SP[i % width];
+		Memory &mem = bus(i);
+
+		mem.write(--sp, val >> 8);
+		mem.write(--sp, val & 0xFF);
+		g.SP[i % width] = sp;
+	}
+	accessed();
+}
+
+/**************
+ * Vector ALU *
+ **************/
+
+void Lockstep::alu(u8 op, Vec &a, Vec &f, const Vec &b)
+{
+	Vec carry = {};
+	Vec res;
+
+	if (op == 1 || op == 3)
+		carry = (f >> 4) & 1;
+
+	switch (op) {
+	case 0: // ADD, ADC
+	case 1:
+		res = a + b + carry;
+		f = ((Vec)(res == 0) & flag_z) | ((a ^ b ^ res) & 0x10) << 1 |
+		    (((a & b) | ((a | b) & ~res)) >> 7) << 4;
+		a = res;
+		break;
+	case 2: // SUB, SBC, CP
+	case 3:
+	case 7:
+		res = a - b - carry;
+		f = ((Vec)(res == 0) & flag_z) | flag_n | ((a ^ b ^ res) & 0x10) << 1 |
+		    (((~a & b) | ((~a | b) & res)) >> 7) << 4;
+		if (op != 7)
+			a = res;
+		break;
+	case 4: // AND
+		a &= b;
+		f = ((Vec)(a == 0) & flag_z) | flag_h;
+		break;
+	case 5: // XOR
+		a ^= b;
+		f = (Vec)(a == 0) & flag_z;
+		break;
+	case 6: // OR
+		a |= b;
+		f = (Vec)(a == 0) & flag_z;
+		break;
+	}
+}
+
+void Lockstep::inc(Vec &v, Vec &f)
+{
+	v += 1;
+	f = ((Vec)(v == 0) & flag_z) | ((Vec)((v & 0x0F) == 0x00) & flag_h) | (f & flag_c);
+}
+
+void Lockstep::dec(Vec &v, Vec &f)
+{
+	v -= 1;
+	f = ((Vec)(v == 0) & flag_z) | flag_n | ((Vec)((v & 0x0F) == 0x0F) & flag_h) | (f & flag_c);
+}
+
+void Lockstep::shift(u8 op, Vec &v, Vec &f)
+{
+	Vec carry_in = (f >> 4) & 1;
+	Vec carry = (op & 1) ? v & 1 : v >> 7;
+
+	switch (op) {
+	case 0: // RLC
+		v = v << 1 | carry;
+		break;
+	case 1: // RRC
+		v = v >> 1 | carry << 7;
+		break;
+	case 2: // RL
+		v = v << 1 | carry_in;
+		break;
+	case 3: // RR
+		v = v >> 1 | carry_in << 7;
+		break;
+	case 4: // SLA
+		v = v << 1;
+		break;
+	case 5: // SRA
+		v = v >> 1 | (v & 0x80);
+		break;
+	case 6: // SWAP
+		v = v << 4 | v >> 4;
+		carry = Vec{};
+		break;
+	case 7: // SRL
+		v = v >> 1;
+		break;
+	}
+	f = ((Vec)(v == 0) & flag_z) | carry << 4;
+}
+
+/****************
+ * Instructions *
+ ****************/
+
+/* The opcodes step() runs for all lanes, of the 0xCB ones all but (HL) */
+static constexpr std::array<bool, 256> shared_ops = [] {
+	std::array<bool, 256> t{};
+
+	for (unsigned op = 0x40; op < 0xC0; op++) // LD r,r' and ALU A,r
+		t[op] = op != 0x76;
+	for (unsigned y = 0; y < 8; y++) {
+		for (u8 op : {0x04, 0x05, 0x06, 0xC6, 0xC7}) // INC r, DEC r, LD r,n, ALU A,n, RST
+			t[op | y << 3] = true;
+	}
+	for (unsigned i = 0; i < 4; i++) {
+		// LD rr,nn, LD (rr),A, INC rr, ADD HL,rr, LD A,(rr), DEC rr, POP, PUSH
+		for (u8 op : {0x01, 0x02, 0x03, 0x09, 0x0A, 0x0B, 0xC1, 0xC5})
+			t[op | i << 4] = true;
+		for (u8 op : {0x20, 0xC0, 0xC2, 0xC4}) // JR cc, RET cc, JP cc, CALL cc
+			t[op | i << 3] = true;
+	}
+	for (u8 op : {0x00, 0x07, 0x0F, 0x17, 0x18, 0x1F, 0x2F, 0x37, 0x3F, 0xC3, 0xC9, 0xCB, 0xCD, 0xE0, 0xE2,
+		      0xE9, 0xEA, 0xF0, 0xF2, 0xFA})
+		t[op] = true;
+	return t;
+}();
+
+/* Run the instruction at PC_ for all lanes, false if that takes their own
+ * CPUs. Nothing has changed when it returns false.
+ */
+bool Lockstep::step()
+{
+	const Memory &code = lanes_[0]->mem();
+
+	if (!same_code(PC_, 1))
+		return false;
+
+	u8 op = code.read(PC_);
+	u8 len = op == 0xCB ? 2 : 1 + instructions[op].num_args_;
+	if (!shared_ops[op] || (len > 1 && !same_code(PC_, len)))
+		return false;
+
+	u8 n = len > 1 ? code.read(PC_ + 1) : 0;
+	u16 nn = len > 2 ? n | code.read(PC_ + 2) << 8 : n;
+	u8 x = op >> 6, y = (op >> 3) & 7, z = op & 7;
+	u8 cycles = op == 0xCB ? CPU::cb_op_cycles[n] : CPU::op_cycles[op];
+	size_t lanes = lanes_.size();
+
+	if (op == 0xCB && (n & 7) == 6)
+		return false;
+
+	// branches go the same way in every lane or not at all
+	bool taken = true;
+	if ((x == 0 && z == 0 && y >= 4) || (x == 3 && (z == 0 || z == 2 || z == 4) && y < 4)) {
+		int all = uniform([&](size_t i) { return cond(y & 3, i); });
+		if (all < 0)
+			return false;
+		taken = all;
+	}
+
+	// and return to the same address
+	u16 ret = 0;
+	if (taken && (op == 0xC9 || (x == 3 && z == 0 && y < 4))) {
+		cycles_ += cycles;
+		auto addr = [&](size_t i) {
+			u16 sp = groups_[i / width].SP[i % width];
+			Memory &mem = bus(i);
+			return static_cast<u16>(mem.read(sp) | mem.read(sp + 1) << 8);
+		};
+		ret = addr(0);
+		int same = uniform([&](size_t i) { return addr(i) == ret; });
+		cycles_ -= cycles;
+		if (same != 1)
+			return false;
+	}
+	if (op == 0xE9 && uniform([&](size_t i) { return pair(i, 4) == pair(0, 4); }) != 1)
+		return false;
+
+	PC_ += len;
+	cycles_ += cycles;
+
+	if (op == 0xCB) {
+		u8 cx = n >> 6, cy = (n >> 3) & 7, cz = n & 7;
+
+		for (Group &g : groups_) {
+			switch (cx) {
+			case 0: // RLC, RRC, RL, RR, SLA, SRA, SWAP, SRL
+				shift(cy, g.r[cz], g.r[rF]);
+				break;
+			case 1: // BIT
+				g.r[rF] = ((Vec)((g.r[cz] & static_cast<u8>(1 << cy)) == 0) & flag_z) | flag_h | (g.r[rF] & flag_c);
+				break;
+			case 2: // RES
+				g.r[cz] &= static_cast<u8>(~(1 << cy));
+				break;
+			case 3: // SET
+				g.r[cz] |= static_cast<u8>(1 << cy);
+				break;
+			}
+		}
+		return true;
+	}
+
+	switch (x) {
+	case 0:
+		switch (z) {
+		case 0: // NOP, JR n, JR cc,n
+			if (op != 0x00 && taken) {
+				PC_ += static_cast<i8>(n);
+				cycles_ += op != 0x18;
+			}
+			break;
+		case 1: // LD rr,nn, ADD HL,rr
+			for (Group &g : groups_) {
+				if (y == 6) {
+					g.SP = Vec16{} + nn;
+				} else if (!(y & 1)) {
+					g.r[y] = Vec{} + static_cast<u8>(nn >> 8);
+					g.r[y + 1] = Vec{} + static_cast<u8>(nn);
+				} else {
+					Vec16 hl = __builtin_convertvector(g.r[4], Vec16) << 8 |
+						   __builtin_convertvector(g.r[5], Vec16);
+					Vec16 rr = y == 7 ? g.SP
+							  : __builtin_convertvector(g.r[y - 1], Vec16) << 8 |
+								    __builtin_convertvector(g.r[y], Vec16);
+					Vec16 res = hl + rr;
+					Vec16 hc = ((hl ^ rr ^ res) >> 12 & 1) << 5 | ((Vec16)(res < hl) & 1) << 4;
+
+					// Z and the low bits stay
+					g.r[rF] = (g.r[rF] & 0x8F) | __builtin_convertvector(hc, Vec);
+					g.r[4] = __builtin_convertvector(res >> 8, Vec);
+					g.r[5] = __builtin_convertvector(res, Vec);
+				}
+			}
+			break;
+		case 2: // LD (rr),A, LD A,(rr), with HL+ and HL-
+			if (y & 1)
+				load(rA, y < 4 ? y & 2 : 4);
+			else
+				store(y < 4 ? y & 2 : 4, rA);
+			if (y >= 4)
+				inc16(4, y >= 6);
+			break;
+		case 3: // INC rr, DEC rr
+			inc16(y & 6, y & 1);
+			break;
+		case 4: // INC r
+		case 5: // DEC r
+			if (y == 6) {
+				for (size_t i = 0; i < lanes; i++)
+					val_[i / width][i % width] = bus(i).read(pair(i, 4));
+				accessed();
+			}
+			for (size_t k = 0; k < groups_.size(); k++) {
+				Group &g = groups_[k];
+				Vec &v = y == 6 ? val_[k] : g.r[y];
+				if (z == 4)
+					inc(v, g.r[rF]);
+				else
+					dec(v, g.r[rF]);
+			}
+			if (y == 6) {
+				for (size_t i = 0; i < lanes; i++)
+					bus(i).write(pair(i, 4), val_[i / width][i % width]);
+				accessed();
+			}
+			break;
+		case 6: // LD r,n
+			if (y == 6) {
+				for (size_t i = 0; i < lanes; i++)
+					bus(i).write(pair(i, 4), n);
+				accessed();
+			} else {
+				for (Group &g : groups_)
+					g.r[y] = Vec{} + n;
+			}
+			break;
+		case 7: // RLCA, RRCA, RLA, RRA, CPL, SCF, CCF
+			for (Group &g : groups_) {
+				if (y < 4)
+					shift(y, g.r[rA], g.r[rF]);
+				else if (y == 5)
+					g.r[rA] = ~g.r[rA];
+				else if (y == 6)
+					g.r[rF] |= flag_c;
+				else
+					g.r[rF] ^= flag_c;
+			}
+			break;
+		}
+		break;
+
+	case 1: // LD r,r'
+		if (z == 6)
+			load(y, 4);
+		else if (y == 6)
+			store(4, z);
+		else
+			for (Group &g : groups_)
+				g.r[y] = g.r[z];
+		break;
+
+	case 2: // ALU A,r
+		if (z == 6) {
+			for (size_t i = 0; i < lanes; i++)
+				val_[i / width][i % width] = bus(i).read(pair(i, 4));
+			accessed();
+		}
+		for (size_t k = 0; k < groups_.size(); k++) {
+			Group &g = groups_[k];
+			alu(y, g.r[rA], g.r[rF], z == 6 ? val_[k] : g.r[z]);
+		}
+		break;
+
+	case 3:
+		switch (z) {
+		case 0: // RET cc, LDH (n),A, LDH A,(n)
+			if (y < 4) {
+				if (taken) {
+					for (Group &g : groups_)
+						g.SP += 2;
+					PC_ = ret;
+					cycles_ += 3;
+				}
+				break;
+			}
+			for (size_t i = 0; i < lanes; i++) {
+				if (op == 0xE0)
+					bus(i).write(0xFF00 + n, get(i, rA));
+				else
+					set(i, rA, bus(i).read(0xFF00 + n));
+			}
+			accessed();
+			break;
+		case 1: // POP rr, RET, JP (HL)
+			if (op == 0xC9) {
+				for (Group &g : groups_)
+					g.SP += 2;
+				PC_ = ret;
+			} else if (op == 0xE9) {
+				PC_ = pair(0, 4);
+			} else {
+				// AF is popped into A and F
+				u8 hi = y == 6 ? rA : y, lo = y == 6 ? rF : y + 1;
+				for (size_t i = 0; i < lanes; i++) {
+					Group &g = groups_[i / width];
+					u16 sp = g.SP[i % width];
+					Memory &mem = bus(i);
+
+					set(i, lo, mem.read(sp++));
+					set(i, hi, mem.read(sp++));
+					g.SP[i % width] = sp;
+				}
+				accessed();
+			}
+			break;
+		case 2: // JP cc,nn, LD (C),A, LD (nn),A, LD A,(C), LD A,(nn)
+			if (y < 4) {
+				if (taken) {
+					PC_ = nn;
+					cycles_ += 1;
+				}
+				break;
+			}
+			for (size_t i = 0; i < lanes; i++) {
+				u16 addr = y & 1 ? nn : 0xFF00 + get(i, 1);
+				if (y & 2)
+					set(i, rA, bus(i).read(addr));
+				else
+					bus(i).write(addr, get(i, rA));
+			}
+			accessed();
+			break;
+		case 3: // JP nn
+			PC_ = nn;
+			break;
+		case 4: // CALL cc,nn
+			if (taken) {
+				push(PC_);
+				PC_ = nn;
+				cycles_ += 3;
+			}
+			break;
+		case 5: // PUSH rr, CALL nn
+			if (op == 0xCD) {
+				push(PC_);
+				PC_ = nn;
+				break;
+			}
+			for (size_t i = 0; i < lanes; i++) {
+				Group &g = groups_[i / width];
+				u16 sp = g.SP[i % width];
+				Memory &mem = bus(i);
+
+				mem.write(--sp, get(i, y == 6 ? rA : y));
+				mem.write(--sp, get(i, y == 6 ? rF : y + 1));
+				g.SP[i % width] = sp;
+			}
+			accessed();
+			break;
+		case 6: // ALU A,n
+			for (Group &g : groups_) {
+				Vec b = Vec{} + n;
+				alu(y, g.r[rA], g.r[rF], b);
+			}
+			break;
+		case 7: // RST
+			push(PC_);
+			PC_ = y * 8;
+			break;
+		}
+		break;
+	}
+	return true;
+}
+
+} // namespace mboy
@@ -1,21 +1,62 @@
 #include <iostream>
 
-#include <bios.hpp>
-#include <cpu.hpp>
-#include <memory.hpp>
+#include <batch.hpp>
+#include <emulator.hpp>
+#include <runner.hpp>
 
+#include <cstdlib>
 #include <cstring>
+#include <memory>
+#include <stdexcept>
 
 using namespace mboy;
 
-int main([[maybe_unused]] int argc, [[maybe_unused]] char **argv)
+int main(int argc, char **argv)
 {
-	CPU *cpu = new CPU();
-	Memory *mem = new Memory();
+	const char *rom = nullptr;
+	const char *manifest = nullptr;
+	unsigned jobs = 0;
+	bool skip_boot = false;
 
-	cpu->mem = mem;
-	memcpy(cpu->mem, bios, 256);
-	std::cout << "VAL: " << std::hex << (int)cpu->mem->read(0x100) << std::endl;
+	for (int i = 1; i < argc; i++) {
+		if (!strcmp(argv[i], "--skip-boot")) {
+			skip_boot = true;
+		} else if (!strcmp(argv[i], "--batch") && i + 1 < argc) {
+			manifest = argv[++i];
+		} else if (!strcmp(argv[i], "--jobs") && i + 1 < argc) {
+			jobs = atoi(argv[++i]);
+		} else if (argv[i][0] == '-') {
+			std::cerr << "usage: " << argv[0] << " [--skip-boot] [rom]" << std::endl
+				  << "       " << argv[0] << " --batch <manifest> [--jobs <threads>]" << std::endl;
+			return 1;
+		} else {
+			rom = argv[i];
+		}
+	}
+
+	// headless: run the jobs of the manifest, one JSON line each
+	if (manifest) {
+		try {
+			Batch batch(manifest);
+			Runner runner(jobs);
+			return batch.run(runner, std::cout) ? 1 : 0;
+		} catch (const std::runtime_error &e) {
+			std::cerr << e.what() << std::endl;
+			return 1;
+		}
+	}
+
+	std::unique_ptr<Emulator> emu;
+	try {
+		emu = std::make_unique<Emulator>(rom ? rom : "", skip_boot);
+	} catch (const std::runtime_error &e) {
+		std::cerr << e.what() << std::endl;
+		return 1;
+	}
+	if (Cartridge *cart = emu->cart())
+		std::cout << "ROM: " << cart->title() << std::endl;
+
+	std::cout << "VAL: " << std::hex << (int)emu->mem().read(0x100) << std::endl;
 	return 0;
 }
 
@@ -1,24 +1,335 @@
+
+
 #include <memory.hpp>
+#include <state.hpp>
+
+#include <algorithm>
+#include <cstring>
+#include <initializer_list>
+#include <stdexcept>
 
 namespace mboy {
 
 Memory::Memory()
 {
+	for (unsigned page = 0; page < 0xFF; page++) {
+		u8 real = ram_page(page);
+
+		ram_[real] = zero_page();
+		map(page, ram_[real]->data(), ram_[real]->data());
+		alias_[page] = page;
+	}
+	for (unsigned page = 0xE0; page < 0xFE; page++) {
+		alias_[page] = page - 0x20;
+		alias_[page - 0x20] = page;
+	}
+
+	ram_[0xFF] = zero_page();
+	handle(0xFF, io_read, io_write, this);
+	alias_[0xFF] = 0xFF;
+
+	shared_.set();
+	for (unsigned page = 0; page < 256; page++)
+		update_write(page);
 }
 
-u8 Memory::read(u16 addr) const
+const std::shared_ptr<Memory::Page> &Memory::zero_page()
 {
-	return this->mem[addr];
+	static const std::shared_ptr<Page> zero = std::make_shared<Page>();
+	return zero;
 }
 
-void Memory::write(u16 addr, u8 val) {
-	this->mem[addr] = val;
+Memory::Memory(Memory &other, Branch) : Memory()
+{
+	// other drops the write pointers of what is shared from now on
+	for (unsigned page = 0; page < 256; page++) {
+		if (other.writable_[page] && other.writable_[page] == other.ram_[ram_page(page)]->data()) {
+			other.shared_[page] = true;
+			other.update_write(page);
+		}
+	}
+
+	for (unsigned page = 0; page < 0xFF; page++) {
+		u8 real = ram_page(page);
+
+		ram_[real] = other.ram_[real];
+		map(page, ram_[real]->data(), ram_[real]->data());
+	}
+	ram_[0xFF] = other.ram_[0xFF];
+	shared_.set();
+
+	if (other.boot_)
+		mount_boot(other.boot_);
+	boot_rom_ = other.boot_rom_;
+
+	tracking_ = other.tracking_;
+	epoch_ = other.epoch_;
+	std::copy(std::begin(other.written_), std::end(other.written_), written_);
+	std::copy(std::begin(other.page_gen_), std::end(other.page_gen_), page_gen_);
+	for (unsigned page = 0; page < 256; page++)
+		update_write(page);
 }
 
 u8& Memory::operator[](u16 addr)
 {
-	return this->mem[addr];
+	u8 page = ram_page(addr >> 8);
+
+	own(page);
+	if (tracking_)
+		dirtied(page);
+	return (*ram_[page])[addr & 0xFF];
 }
 
-} /* namespace */
+/* Give RAM page real a copy of its own if a branch still shares it */
+void Memory::own(u8 real)
+{
+	if (!shared_[real] && !shared_[alias_[real]] && ram_[real].use_count() == 1)
+		return;
+
+	if (ram_[real].use_count() > 1) {
+		const u8 *old = ram_[real]->data();
+
+		ram_[real] = std::make_shared<Page>(*ram_[real]);
+		for (u8 p : {real, alias_[real]}) {
+			if (read_slot(p) == old)
+				read_slot(p) = ram_[real]->data();
+			if (writable_[p] == old)
+				writable_[p] = ram_[real]->data();
+		}
+	}
+
+	for (u8 p : {real, alias_[real]}) {
+		shared_[p] = false;
+		update_write(p);
+	}
+}
+
+/* Without a write pointer, writes take the slow path */
+void Memory::update_write(u8 page)
+{
+	bool clean = tracking_ && written_[page] < epoch_;
+
+	write_[page] = watched_[page] || data_watched_[page] || shared_[page] || clean ? nullptr : writable_[page];
+}
+
+/**************
+ * Page Table *
+ **************/
 
+void Memory::map(u8 page, const u8 *read, u8 *write)
+{
+	const u8 *&slot = read_slot(page);
+
+	// MBCs remap every bank on each register write, most stay the same
+	if (slot == read && writable_[page] == write)
+		return;
+
+	slot = read;
+	writable_[page] = write;
+	shared_[page] = false;
+	remapped(page);
+}
+
+/* Whatever was decoded from the page is gone */
+void Memory::remapped(u8 page)
+{
+	if (watched_[page])
+		code_gen_++;
+	watched_[page] = false;
+	data_watched_[page] = false;
+	written_[page] = epoch_;
+	update_write(page);
+	page_gen_[page]++;
+}
+
+void Memory::handle(u8 page, read_handler read, write_handler write, void *ctx)
+{
+	// the same handlers as another page, else a free slot
+	unsigned i = 0;
+	while ((read || write) && ++i < max_handlers) {
+		const Handler &h = handlers_[i];
+		if ((!h.read_ && !h.write_) || (h.read_ == read && h.write_ == write && h.ctx_ == ctx))
+			break;
+	}
+	if (i == max_handlers)
+		throw std::logic_error("Memory: too many page handlers");
+	handlers_[i] = {read, write, ctx};
+	handler_[page] = i;
+	if (read)
+		read_slot(page) = nullptr;
+	if (write) {
+		writable_[page] = nullptr;
+		update_write(page);
+	}
+}
+
+/* The boot ROM hides page 0 from reads only */
+const u8 *&Memory::read_slot(u8 page)
+{
+	return page == 0 && boot_ ? boot_under_ : read_[page];
+}
+
+u8 Memory::slow_read(u16 addr) const
+{
+	const Handler &h = handlers_[handler_[addr >> 8]];
+	return h.read_ ? h.read_(h.ctx_, addr) : 0xFF;
+}
+
+void Memory::slow_write(u16 addr, u8 val)
+{
+	u8 page = addr >> 8;
+
+	if (watched_[page] || data_watched_[page])
+		invalidate(page);
+	if (shared_[page])
+		own(ram_page(page));
+	if (tracking_ && written_[page] < epoch_)
+		dirtied(page);
+
+	if (u8 *p = writable_[page])
+		p[addr & 0xFF] = val;
+	else if (const Handler &h = handlers_[handler_[page]]; h.write_)
+		h.write_(h.ctx_, addr, val);
+}
+
+/* The first write to a watched page */
+void Memory::invalidate(u8 page)
+{
+	// only code that was decoded may be running
+	if (watched_[page])
+		code_gen_++;
+	for (u8 p : {page, alias_[page]}) {
+		watched_[p] = false;
+		data_watched_[p] = false;
+		update_write(p);
+		page_gen_[p]++;
+	}
+}
+
+void Memory::watch_code(u16 addr)
+{
+	for (u8 p : {static_cast<u8>(addr >> 8), alias_[addr >> 8]}) {
+		watched_[p] = true;
+		update_write(p);
+	}
+}
+
+void Memory::watch_data(u16 addr)
+{
+	for (u8 p : {static_cast<u8>(addr >> 8), alias_[addr >> 8]}) {
+		data_watched_[p] = true;
+		update_write(p);
+	}
+}
+
+/***************
+ * Dirty Pages *
+ ***************/
+
+void Memory::track_dirty(bool on)
+{
+	tracking_ = on;
+	for (unsigned page = 0; page < 256; page++) {
+		written_[page] = epoch_;
+		update_write(page);
+	}
+}
+
+u32 Memory::mark()
+{
+	// every page is clean now
+	epoch_++;
+	if (tracking_)
+		std::fill_n(write_, 256, nullptr);
+	return epoch_;
+}
+
+std::bitset<256> Memory::dirty_pages(u32 marker) const
+{
+	std::bitset<256> pages;
+
+	for (unsigned page = 0; page < 256; page++)
+		pages[page] = dirty(page, marker);
+	return pages;
+}
+
+void Memory::dirtied(u8 page)
+{
+	for (u8 p : {page, alias_[page]}) {
+		written_[p] = epoch_;
+		update_write(p);
+	}
+}
+
+/************
+ * Boot ROM *
+ ************/
+
+void Memory::mount_boot(const u8 *rom)
+{
+	if (!boot_)
+		boot_under_ = read_[0];
+	boot_ = rom;
+	boot_rom_ = rom;
+	read_[0] = rom;
+	remapped(0);
+}
+
+void Memory::unmount_boot()
+{
+	if (!boot_)
+		return;
+	read_[0] = boot_under_;
+	boot_ = nullptr;
+	boot_under_ = nullptr;
+	remapped(0);
+}
+
+/***************
+ * Save States *
+ ***************/
+
+void Memory::save(State &s, u32 since) const
+{
+	s.booting = booting();
+	std::memset(s.unused, 0, sizeof(s.unused));
+	for (unsigned page = 0; page < 256; page++)
+		if (dirty(page, since))
+			std::memcpy(&s.mem[page << 8], ram_[ram_page(page)]->data(), 256);
+}
+
+void Memory::load(const State &s)
+{
+	// pages which stay the same keep being shared
+	for (unsigned page = 0; page < 256; page++) {
+		if (ram_[page] && std::memcmp(ram_[page]->data(), &s.mem[page << 8], 256)) {
+			own(page);
+			std::memcpy(ram_[page]->data(), &s.mem[page << 8], 256);
+		}
+	}
+	if (s.booting && boot_rom_)
+		mount_boot(boot_rom_);
+	else
+		unmount_boot();
+
+	for (unsigned page = 0; page < 256; page++)
+		remapped(page);
+	code_gen_++;
+}
+
+u8 Memory::io_read(void *ctx, u16 addr)
+{
+	return (*static_cast<Memory *>(ctx))[addr];
+}
+
+void Memory::io_write(void *ctx, u16 addr, u8 val)
+{
+	Memory *m = static_cast<Memory *>(ctx);
+
+	// written by the last instruction of the boot ROM
+	if (addr == 0xFF50 && (val & 0x01))
+		m->unmount_boot();
+	(*m)[addr] = val;
+}
+
+} /* namespace */
@@ -0,0 +1,307 @@
+#include <ppu.hpp>
+#include <cpu.hpp>
+#include <frame_ring.hpp>
+#include <kernels.hpp>
+#include <scheduler.hpp>
+#include <state.hpp>
+
+#include <algorithm>
+#include <cstring>
+
+namespace mboy
+{
+void PPU::attach(Memory *m)
+{
+	mem_ = m;
+	// decoded with the first line
+	std::fill(std::begin(tile_gen_), std::end(tile_gen_), ~0u);
+}
+
+u8 PPU::read(u16 addr)
+{
+	if (addr == LY)
+		return ly_;
+	return 0x80 | (io(STAT) & 0x78) | (ly_ == io(LYC)) << 2 | mode_;
+}
+
+u8 PPU::write(u16 addr, u8 val, u64 now)
+{
+	switch (addr) {
+	case LCDC:
+		if ((val & 0x80) && !on_) {
+			// starts over with the first line
+			on_ = true;
+			line_start_ = now;
+			ly_ = 0;
+			mode_ = oam_search;
+			start_frame();
+		} else if (!(val & 0x80) && on_) {
+			on_ = false;
+			ly_ = 0;
+			mode_ = hblank;
+			frame_.fill(0);
+		}
+		break;
+	case DMA:
+		for (u16 i = 0; i < 0xA0; i++)
+			mem_->write(0xFE00 | i, mem_->read(val << 8 | i));
+		return 0;
+	default:
+		break;
+	}
+	return check_stat(io(STAT), io(LYC));
+}
+
+u8 PPU::update(u64 now)
+{
+	if (next_boundary() > now)
+		return 0;
+
+	// neither changes without a write, which updates first
+	u8 stat = io(STAT);
+	u8 lyc = io(LYC);
+	u8 irq = 0;
+
+	while (next_boundary() <= now) {
+		bool transferred = mode_ == transfer;
+
+		step(ly_, mode_, line_start_);
+		if (transferred) {
+			if (draw_)
+				render();
+			// counted on skipped frames too, save states do not depend on skipping
+			if (window_on_line())
+				window_line_++;
+		} else if (mode_ == vblank && ly_ == height) {
+			frames_++;
+			irq |= CPU::int_vblank;
+			if (ring_ && draw_)
+				ring_->publish(frame_.data(), frames_, line_start_);
+		} else if (mode_ == oam_search && ly_ == 0) {
+			start_frame();
+		}
+		irq |= check_stat(stat, lyc);
+	}
+	return irq;
+}
+
+u64 PPU::next_boundary() const
+{
+	if (!on_)
+		return Scheduler::never;
+
+	u8 ly = ly_;
+	u8 mode = mode_;
+	u64 start = line_start_;
+	return step(ly, mode, start);
+}
+
+u64 PPU::next_event()
+{
+	if (!on_)
+		return Scheduler::never;
+
+	u8 stat = io(STAT);
+	u8 lyc = io(LYC);
+	u8 ly = ly_;
+	u8 mode = mode_;
+	u64 start = line_start_;
+
+	// the first line at the latest
+	for (;;) {
+		u64 when = step(ly, mode, start);
+		if (acts(ly, mode, stat, lyc))
+			return when;
+	}
+}
+
+/* Move ly and mode of the line starting at start past the next boundary,
+ * returns the cycle it is at
+ */
+u64 PPU::step(u8 &ly, u8 &mode, u64 &start)
+{
+	switch (mode) {
+	case oam_search:
+		mode = transfer;
+		return start + 20;
+	case transfer:
+		mode = hblank;
+		return start + 20 + 43;
+	default:
+		start += line_cycles;
+		ly = ly + 1u < lines ? ly + 1 : 0;
+		mode = ly < height ? oam_search : vblank;
+		return start;
+	}
+}
+
+/* Whether the PPU has to act on entering mode on line ly: to draw the line
+ * when its transfer ends, whether the frame is drawn or not, to decide
+ * about a new frame, or for an interrupt that may be due
+ */
+bool PPU::acts(u8 ly, u8 mode, u8 stat, u8 lyc) const
+{
+	switch (mode) {
+	case transfer:
+		return false;
+	case hblank:
+		return true;
+	default:
+		return ly == 0 || ly == height || (stat & 0x20 && mode == oam_search) || (stat & 0x40 && ly == lyc);
+	}
+}
+
+/* Decide whether the frame starting now is drawn */
+void PPU::start_frame()
+{
+	window_line_ = 0;
+	draw_ = skip_ != never_draw && skipped_ >= skip_;
+	skipped_ = draw_ ? 0 : skipped_ + 1;
+}
+
+/* The STAT interrupt is requested when any of its enabled sources becomes
+ * true while none was
+ */
+u8 PPU::check_stat(u8 stat, u8 lyc)
+{
+	bool line = on_ && ((stat & 0x40 && ly_ == lyc) || (stat & 0x08 && mode_ == hblank) ||
+			    (stat & 0x10 && mode_ == vblank) || (stat & 0x20 && mode_ == oam_search));
+	bool rising = line && !stat_line_;
+
+	stat_line_ = line;
+	return rising ? CPU::int_stat : 0;
+}
+
+/*************
+ * Rendering *
+ *************/
+
+/* Decode the tiles of the VRAM pages written since they were last decoded */
+void PPU::decode_tiles()
+{
+	for (unsigned page = 0; page < tile_pages; page++) {
+		u16 addr = 0x8000 + page * 256;
+
+		if (mem_->page_gen(addr) == tile_gen_[page])
+			continue;
+		// watched before it is read, so no write goes unseen
+		mem_->watch_data(addr);
+		tile_gen_[page] = mem_->page_gen(addr);
+
+		u8 rows[256];
+		for (unsigned i = 0; i < 256; i++)
+			rows[i] = mem_->read(addr + i);
+		PixelKernels::best().decode(rows, tile_[page * 16].data(), 128);
+	}
+}
+
+/* Colour numbers of the tile map at map, scrolled by x and y, into line
+ * from pixel from on
+ */
+void PPU::draw_tiles(u8 *line, u16 map, u8 x, u8 y, unsigned from)
+{
+	bool unsigned_tiles = io(LCDC) & 0x10;
+
+	for (unsigned i = from; i < width; x = (x | 7) + 1) {
+		u8 tile = mem_->read(map + (y / 8) * 32 + x / 8);
+		const u8 *row = &tile_[unsigned_tiles ? tile : 256 + static_cast<i8>(tile)][y % 8 * 8];
+		unsigned n = std::min(8u - x % 8, width - i);
+
+		std::memcpy(line + i, row + x % 8, n);
+		i += n;
+	}
+}
+
+/* Whether the window covers part of line ly_, update() counts its lines */
+bool PPU::window_on_line()
+{
+	u8 lcdc = io(LCDC);
+
+	return (lcdc & 0x21) == 0x21 && ly_ >= io(WY) && io(WX) < width + 7;
+}
+
+void PPU::render()
+{
+	u8 lcdc = io(LCDC);
+	u8 *out = &frame_[ly_ * width];
+	u8 bg[width] = {}; // colour numbers before BGP, sprites may hide behind 1 - 3
+
+	decode_tiles();
+
+	// bit 0 turns both background and window off on a DMG
+	if (lcdc & 0x01) {
+		draw_tiles(bg, lcdc & 0x08 ? 0x9C00 : 0x9800, io(SCX), io(SCY) + ly_, 0);
+
+		u8 wx = io(WX);
+		if (window_on_line())
+			draw_tiles(bg, lcdc & 0x40 ? 0x9C00 : 0x9800, wx < 7 ? 7 - wx : 0, window_line_, wx < 7 ? 0 : wx - 7);
+	}
+
+	PixelKernels::best().map(bg, out, lcdc & 0x01 ? io(BGP) : 0, width);
+
+	if (!(lcdc & 0x02))
+		return;
+
+	// the first ten sprites on the line in OAM, the one further left wins,
+	// on a tie the one first in OAM
+	unsigned h = lcdc & 0x04 ? 16 : 8;
+	u8 found[10];
+	unsigned n = 0;
+
+	for (unsigned i = 0; i < 40 && n < 10; i++) {
+		int y = mem_->read(0xFE00 + 4 * i) - 16;
+		if (ly_ >= y && ly_ < y + static_cast<int>(h))
+			found[n++] = i;
+	}
+	std::stable_sort(found, found + n, [this](u8 a, u8 b) {
+		return mem_->read(0xFE01 + 4 * a) < mem_->read(0xFE01 + 4 * b);
+	});
+
+	bool taken[width] = {};
+
+	for (unsigned i = 0; i < n; i++) {
+		u16 oam = 0xFE00 + 4 * found[i];
+		int x = mem_->read(oam + 1) - 8;
+		u8 tile = mem_->read(oam + 2);
+		u8 attr = mem_->read(oam + 3);
+		unsigned row = ly_ - (mem_->read(oam) - 16);
+
+		if (attr & 0x40)
+			row = h - 1 - row;
+		if (h == 16)
+			tile &= 0xFE;
+		const u8 *px = &tile_[tile + row / 8][row % 8 * 8];
+
+		u8 pal = io(attr & 0x10 ? OBP1 : OBP0);
+		for (int j = 0; j < 8; j++) {
+			int col = x + (attr & 0x20 ? 7 - j : j);
+			if (col < 0 || col >= static_cast<int>(width) || taken[col] || !px[j])
+				continue;
+			// a sprite behind the background still hides those after it
+			taken[col] = true;
+			if (!(attr & 0x80) || !bg[col])
+				out[col] = pal >> 2 * px[j] & 3;
+		}
+	}
+}
+
+/***************
+ * Save States *
+ ***************/
+
+void PPU::save(State &s) const
+{
+	s.ppu = {line_start_, ly_, mode_, window_line_, stat_line_, on_, {}};
+}
+
+void PPU::load(const State &s)
+{
+	line_start_ = s.ppu.line_start;
+	ly_ = s.ppu.ly;
+	mode_ = s.ppu.mode;
+	window_line_ = s.ppu.window_line;
+	stat_line_ = s.ppu.stat_line;
+	on_ = s.ppu.on;
+}
+
+} // namespace mboy
@@ -0,0 +1,115 @@
+#include <rewind.hpp>
+
+#include <algorithm>
+#include <cstring>
+
+namespace mboy
+{
+static u64 load(const u8 *p, size_t word)
+{
+	u64 v;
+	std::memcpy(&v, p + word * 8, 8);
+	return v;
+}
+
+static void store(u8 *p, size_t word, u64 v)
+{
+	std::memcpy(p + word * 8, &v, 8);
+}
+
+Rewind::Rewind(size_t frames) : deltas_(std::max<size_t>(frames, 1) - 1) {}
+
+void Rewind::push(const State &s)
+{
+	push(s, std::bitset<256>().set());
+}
+
+void Rewind::push(const State &s, const std::bitset<256> &mem_pages)
+{
+	const u8 *src = reinterpret_cast<const u8 *>(&s);
+	u8 *dst = reinterpret_cast<u8 *>(newest_.get());
+
+	if (!have_ || s.size() != size_) {
+		std::memcpy(dst, src, s.size());
+		size_ = s.size();
+		have_ = true;
+		count_ = 0;
+		return;
+	}
+
+	if (deltas_.empty()) {
+		std::memcpy(dst, src, size_);
+		return;
+	}
+
+	// the tail of a word past size_ is copied along with it
+	size_t words = (size_ + 7) / 8;
+	size_t mem = (s.mem - src) / 8; // first word of State::mem
+	std::vector<u64> &d = deltas_[head_];
+
+	d.clear();
+	for (size_t i = 0; i < words;) {
+		size_t start = i;
+		while (i < words) {
+			// most of the state is unchanged, skip it a page at a time
+			bool page = i >= mem && i < mem + sizeof(s.mem) / 8 && (i - mem) % 32 == 0;
+			if (page && !mem_pages[(i - mem) / 32])
+				i += 32;
+			else if (i % 32 == 0 && i + 32 <= words && !std::memcmp(src + i * 8, dst + i * 8, 256))
+				i += 32;
+			else if (load(src, i) == load(dst, i))
+				i++;
+			else
+				break;
+		}
+		u64 same = i - start;
+
+		size_t run = d.size();
+		d.push_back(0);
+		start = i;
+		for (u64 x; i < words && (x = load(src, i) ^ load(dst, i)); i++) {
+			d.push_back(x);
+			store(dst, i, load(src, i));
+		}
+		d[run] = same << 32 | (i - start);
+	}
+
+	head_ = (head_ + 1) % deltas_.size();
+	count_ = std::min(count_ + 1, deltas_.size());
+}
+
+bool Rewind::pop(State &s)
+{
+	if (!have_)
+		return false;
+
+	std::memcpy(&s, newest_.get(), size_);
+	if (!count_) {
+		have_ = false;
+		return true;
+	}
+
+	head_ = (head_ + deltas_.size() - 1) % deltas_.size();
+	count_--;
+
+	u8 *dst = reinterpret_cast<u8 *>(newest_.get());
+	const std::vector<u64> &d = deltas_[head_];
+	size_t i = 0;
+	for (size_t t = 0; t < d.size();) {
+		u64 run = d[t++];
+		i += run >> 32;
+		for (u64 n = run & 0xFFFFFFFF; n; n--, i++)
+			store(dst, i, load(dst, i) ^ d[t++]);
+	}
+	return true;
+}
+
+size_t Rewind::bytes() const
+{
+	size_t n = sizeof(State);
+	for (const std::vector<u64> &d : deltas_)
+		n += d.capacity() * sizeof(u64);
+	return n;
+}
+
+} // namespace mboy
@@ -0,0 +1,182 @@
+#include <runner.hpp>
+
+#include <algorithm>
+
+namespace mboy
+{
+Runner::Runner(unsigned threads)
+{
+	if (!threads)
+		threads = std::max(1u, std::thread::hardware_concurrency());
+
+	for (unsigned i = 0; i < threads; i++)
+		queues_.push_back(std::make_unique<Queue>());
+	for (unsigned i = 1; i < threads; i++)
+		threads_.emplace_back(&Runner::helper, this, i);
+}
+
+Runner::~Runner()
+{
+	{
+		std::lock_guard<std::mutex> l(lock_);
+		quit_ = true;
+	}
+	start_.notify_all();
+	for (std::thread &t : threads_)
+		t.join();
+}
+
+void Runner::run(size_t tasks, const std::function<bool(size_t)> &step)
+{
+	if (!tasks)
+		return;
+
+	// the helpers are waiting, nobody else touches the queues
+	for (std::unique_ptr<Queue> &q : queues_)
+		q->tasks_.clear();
+	for (size_t i = 0; i < tasks; i++)
+		queues_[i % queues_.size()]->tasks_.push_back(i);
+	step_ = &step;
+	left_ = tasks;
+	failed_ = false;
+	error_ = nullptr;
+
+	{
+		std::lock_guard<std::mutex> l(lock_);
+		batch_++;
+		busy_ = threads_.size();
+	}
+	start_.notify_all();
+
+	work(0);
+
+	std::unique_lock<std::mutex> l(lock_);
+	done_.wait(l, [this] { return !busy_; });
+	step_ = nullptr;
+	if (error_)
+		std::rethrow_exception(error_);
+}
+
+void Runner::run_for(const std::vector<Emulator *> &emus, u64 cycles, u64 slice)
+{
+	std::vector<u64> left(emus.size(), cycles);
+
+	run(emus.size(), [&](size_t i) {
+		u64 ran = emus[i]->run_for(std::min(left[i], slice));
+		left[i] -= std::min(left[i], ran);
+		return left[i] > 0;
+	});
+}
+
+void Runner::helper(unsigned self)
+{
+	u64 seen = 0;
+
+	for (;;) {
+		{
+			std::unique_lock<std::mutex> l(lock_);
+			start_.wait(l, [&] { return quit_ || batch_ != seen; });
+			if (quit_)
+				return;
+			seen = batch_;
+		}
+
+		work(self);
+
+		std::lock_guard<std::mutex> l(lock_);
+		if (!--busy_)
+			done_.notify_one();
+	}
+}
+
+void Runner::work(unsigned self)
+{
+	size_t task;
+
+	while (left_ && !failed_) {
+		if (!take(self, task) && !wait_for_task(self, task))
+			continue;
+
+		bool more = false;
+		try {
+			more = (*step_)(task);
+		} catch (...) {
+			std::lock_guard<std::mutex> l(lock_);
+			if (!error_)
+				error_ = std::current_exception();
+			failed_ = true;
+		}
+
+		if (failed_) {
+			wake();
+		} else if (more) {
+			bool idle;
+			{
+				Queue &q = *queues_[self];
+				std::lock_guard<std::mutex> l(q.lock_);
+				q.tasks_.push_back(task);
+				// a thread counted idle after this looks at q after us
+				idle = idle_;
+			}
+			// waking costs a lock, only pay for it when someone waits
+			if (idle)
+				wake();
+		} else if (!--left_) {
+			wake();
+		}
+	}
+}
+
+/* The last tasks are running elsewhere: sleep until one is queued again,
+ * false if there is none to take after all
+ */
+bool Runner::wait_for_task(unsigned self, size_t &task)
+{
+	u64 seen;
+	{
+		std::lock_guard<std::mutex> l(lock_);
+		seen = requeued_;
+		idle_++;
+	}
+
+	// a task queued before idle_ went up is in its queue by now, one queued
+	// later bumps requeued_
+	bool found = take(self, task);
+	std::unique_lock<std::mutex> l(lock_);
+	if (!found)
+		queued_.wait(l, [&] { return requeued_ != seen || !left_ || failed_; });
+	idle_--;
+	return found;
+}
+
+void Runner::wake()
+{
+	{
+		std::lock_guard<std::mutex> l(lock_);
+		requeued_++;
+	}
+	queued_.notify_all();
+}
+
+/* The newest task of our own, else the oldest of somebody else's */
+bool Runner::take(unsigned self, size_t &task)
+{
+	for (unsigned i = 0; i < queues_.size(); i++) {
+		Queue &q = *queues_[(self + i) % queues_.size()];
+		std::lock_guard<std::mutex> l(q.lock_);
+
+		if (q.tasks_.empty())
+			continue;
+		if (!i) {
+			task = q.tasks_.back();
+			q.tasks_.pop_back();
+		} else {
+			task = q.tasks_.front();
+			q.tasks_.pop_front();
+		}
+		return true;
+	}
+	return false;
+}
+
+} // namespace mboy
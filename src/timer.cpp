@@ -0,0 +1,79 @@
+#include <timer.hpp>
+
+namespace mboy
+{
+u8 Timer::read(u16 addr, u64 now)
+{
+	switch (addr) {
+	case 0xFF04: // DIV, the counter advances 4 per M-cycle
+		return (now - div_base_) >> 6;
+	case 0xFF05:
+		return tima_;
+	case 0xFF06:
+		return tma_;
+	default:
+		return 0xF8 | tac_;
+	}
+}
+
+/* The caller has to update() first, so TIMA is counted with the old settings */
+void Timer::write(u16 addr, u8 val, u64 now)
+{
+	switch (addr) {
+	case 0xFF04:
+		div_base_ = now;
+		break;
+	case 0xFF05:
+		tima_ = val;
+		break;
+	case 0xFF06:
+		tma_ = val;
+		break;
+	default:
+		tac_ = val & 0x07;
+		break;
+	}
+	tima_base_ = now;
+}
+
+void Timer::set_counter(u16 value, u64 now)
+{
+	// wraps below 0 early on, differences to it stay right
+	div_base_ = now - value / 4;
+	tima_base_ = now;
+}
+
+bool Timer::update(u64 now)
+{
+	u64 n = enabled() ? edges(now) - edges(tima_base_) : 0;
+	u64 left = 256 - tima_;
+
+	tima_base_ = now;
+	if (n < left) {
+		tima_ += n;
+		return false;
+	}
+	// reload from TMA, and wrap again for every further 256 - TMA edges
+	tima_ = tma_ + (n - left) % (256 - tma_);
+	return true;
+}
+
+u64 Timer::next_overflow() const
+{
+	if (!enabled())
+		return Scheduler::never;
+	return div_base_ + (edges(tima_base_) + 256 - tima_) * period();
+}
+
+u64 Timer::period() const
+{
+	static constexpr u64 periods[4] = {256, 4, 16, 64};
+	return periods[tac_ & 0x03];
+}
+
+u64 Timer::edges(u64 now) const
+{
+	return (now - div_base_) / period();
+}
+
+} // namespace mboy